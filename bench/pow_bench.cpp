@@ -0,0 +1,85 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+// Benchmark of powInteger against std::pow over every exponent isSmallIntegerExponent accepts
+// Usage: pow_bench [rounds]; prints nanoseconds per call of each, their ratio and the largest relative difference
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+#include "postfix.hpp"
+
+// Number of bases each exponent is raised to per round
+constexpr size_t BASE_COUNT = 4096;
+
+// Time rounds passes of power over the bases, in nanoseconds per call; sum keeps the results alive
+template <typename Power>
+static double timeCalls(const std::vector<double>& bases, const int rounds, Power power, double& sum)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (const double base : bases)
+        {
+            sum += power(base);
+        }
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(rounds) * static_cast<double>(bases.size()));
+}
+
+int main(int argc, char* argv[])
+{
+    const int rounds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+
+    // Bases around 1, so that even the largest exponents stay finite
+    std::mt19937_64 random(42);
+    std::uniform_real_distribution<double> distribution(0.5, 2.0);
+    std::vector<double> bases(BASE_COUNT);
+    for (double& base : bases)
+    {
+        base = random() % 2 == 0 ? distribution(random) : -distribution(random);
+    }
+
+    std::printf("%9s %14s %14s %8s %14s\n", "exponent", "powInteger ns", "std::pow ns", "speedup", "max rel diff");
+
+    double sum = 0.0;
+    double totalInteger = 0.0;
+    double totalPow = 0.0;
+    for (long long exponent = -MAX_INTEGER_EXPONENT; exponent <= MAX_INTEGER_EXPONENT; ++exponent)
+    {
+        const double asDouble = static_cast<double>(exponent);
+        if (!isSmallIntegerExponent(asDouble))
+        {
+            continue;
+        }
+
+        const double integerTime =
+            timeCalls(bases, rounds, [exponent](const double base) { return powInteger(base, exponent); }, sum);
+        const double powTime =
+            timeCalls(bases, rounds, [asDouble](const double base) { return std::pow(base, asDouble); }, sum);
+        totalInteger += integerTime;
+        totalPow += powTime;
+
+        double maxDifference = 0.0;
+        for (const double base : bases)
+        {
+            const double expected = std::pow(base, asDouble);
+            maxDifference = std::max(maxDifference, std::abs(powInteger(base, exponent) - expected) / std::abs(expected));
+        }
+
+        std::printf("%9lld %14.2f %14.2f %7.2fx %14.3g\n", exponent, integerTime, powTime, powTime / integerTime,
+                    maxDifference);
+    }
+
+    std::printf("%9s %14.2f %14.2f %7.2fx\n", "mean", totalInteger / (2 * MAX_INTEGER_EXPONENT + 1),
+                totalPow / (2 * MAX_INTEGER_EXPONENT + 1), totalPow / totalInteger);
+
+    // Printed so the timed calls cannot be optimized away
+    std::printf("checksum %g\n", sum);
+    return 0;
+}
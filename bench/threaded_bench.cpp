@@ -0,0 +1,178 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+// Benchmark of the threaded register code against evaluation from the expression text
+// Generates a corpus of random expressions in x and y, each with its own values for them, and times:
+//   postfix    Evaluator::evaluate on the text with the values written in, which lexes and runs the
+//              postfix program without compiling
+//   cached     tryEvaluate on the same text, the path of evaluateExpression: an expression cache lookup,
+//              then the threaded code of the cached, constant-folded program
+//   threaded   CompiledExpression::evaluate of the expression compiled once with x and y as variables
+// Usage: threaded_bench [expressions] [rounds]
+
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+#include "calculator.hpp"
+
+// Append a random expression of at most depth levels of operators
+static void generate(std::mt19937_64& random, const int depth, std::string& expression)
+{
+    if (depth == 0 || random() % 4 == 0)
+    {
+        switch (random() % 8)
+        {
+            case 0:
+                expression += "pi";
+                break;
+            case 1:
+                expression += "e";
+                break;
+            case 2:
+            case 3:
+                expression += random() % 2 == 0 ? 'x' : 'y';
+                break;
+            case 4:
+                expression += std::to_string(1 + random() % 9) + "." + std::to_string(random() % 100);
+                break;
+            default:
+                expression += std::to_string(1 + random() % 99);
+                break;
+        }
+        return;
+    }
+
+    static constexpr char OPERATORS[] = {'+', '-', '*', '/', '^'};
+    const char op = OPERATORS[random() % sizeof(OPERATORS)];
+
+    expression += '(';
+    generate(random, depth - 1, expression);
+    expression += ' ';
+    expression += op;
+    expression += ' ';
+    if (op == '^')
+    {
+        expression += std::to_string(random() % 5);
+    }
+    else
+    {
+        generate(random, depth - 1, expression);
+    }
+    expression += ')';
+}
+
+// Replace every x and y by its value in parentheses
+static std::string substitute(const std::string& expression, const std::string& x, const std::string& y)
+{
+    std::string text;
+    for (const char c : expression)
+    {
+        if (c == 'x' || c == 'y')
+        {
+            text += '(';
+            text += c == 'x' ? x : y;
+            text += ')';
+        }
+        else
+        {
+            text += c;
+        }
+    }
+    return text;
+}
+
+// Time rounds passes of evaluate over the corpus, in nanoseconds per expression; sum keeps the results alive
+template <typename Evaluate>
+static double timeCorpus(const size_t size, const int rounds, Evaluate evaluate, double& sum)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; ++round)
+    {
+        for (size_t i = 0; i < size; ++i)
+        {
+            sum += evaluate(i);
+        }
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (static_cast<double>(rounds) * static_cast<double>(size));
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t count = argc > 1 ? static_cast<size_t>(std::max(1, std::atoi(argv[1]))) : 2000;
+    const int rounds = argc > 2 ? std::max(1, std::atoi(argv[2])) : 100;
+
+    // Every text of the corpus stays cached; the thread's cache is created by its first use below
+    ScientificCalculator::expressionCacheSize = std::max(ScientificCalculator::expressionCacheSize, count);
+
+    // Keep the expressions that evaluate without error, so every path computes a value
+    const std::vector<std::string> variables = {"x", "y"};
+    std::mt19937_64 random(42);
+    std::vector<std::string> corpus;
+    std::vector<CompiledExpression> compiled;
+    std::vector<std::vector<double>> values;
+    while (corpus.size() < count)
+    {
+        std::string expression;
+        generate(random, 5, expression);
+        const std::string x = std::to_string(random() % 4) + "." + std::to_string(10 + random() % 90);
+        const std::string y = std::to_string(random() % 4) + "." + std::to_string(10 + random() % 90);
+        std::vector<double> row = {std::stod(x), std::stod(y)};
+
+        std::string text = substitute(expression, x, y);
+        Result<CompiledExpression> result = ScientificCalculator::tryCompile(expression, variables);
+        if (result && result.value().tryEvaluate(row.data()) && ScientificCalculator::tryEvaluate(text))
+        {
+            corpus.push_back(std::move(text));
+            compiled.push_back(std::move(result).value());
+            values.push_back(std::move(row));
+        }
+    }
+    // The paths must agree, up to the rounding of simplifications such as x^2 to x*x
+    size_t differences = 0;
+    double maxDifference = 0.0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const double expected = ScientificCalculator::Evaluator::local().evaluate(corpus[i]).value();
+        const double cached = ScientificCalculator::tryEvaluate(corpus[i]).value();
+        const double threaded = compiled[i].evaluate(values[i].data());
+        for (const double value : {cached, threaded})
+        {
+            if (value == expected || (std::isnan(value) && std::isnan(expected)))
+            {
+                continue;
+            }
+            ++differences;
+            if (std::isfinite(expected) && expected != 0)
+            {
+                maxDifference = std::max(maxDifference, std::abs(value - expected) / std::abs(expected));
+            }
+        }
+    }
+
+    double sum = 0.0;
+    const double postfixTime = timeCorpus(count, rounds, [&](const size_t i) {
+        return ScientificCalculator::Evaluator::local().evaluate(corpus[i]).value();
+    }, sum);
+    const double cachedTime = timeCorpus(count, rounds, [&](const size_t i) {
+        return ScientificCalculator::tryEvaluate(corpus[i]).value();
+    }, sum);
+    const double threadedTime = timeCorpus(count, rounds, [&](const size_t i) {
+        return compiled[i].evaluate(values[i].data());
+    }, sum);
+
+    std::printf("%zu expressions, %d rounds\n", count, rounds);
+    std::printf("%-10s %10.1f ns/expression\n", "postfix", postfixTime);
+    std::printf("%-10s %10.1f ns/expression\n", "cached", cachedTime);
+    std::printf("%-10s %10.1f ns/expression\n", "threaded", threadedTime);
+    std::printf("%zu results differ from postfix, largest relative difference %.3g\n", differences, maxDifference);
+
+    // Printed so the timed calls cannot be optimized away
+    std::printf("checksum %g\n", sum);
+    return 0;
+}
@@ -1,10 +1,139 @@
 // Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
 
-#include "./src/calculator.hpp"
+#include <string>
+#include <cstring>
+#include <limits>
+#include <charconv>
+#include <algorithm>
+#include <thread>
+#include <fstream>
+#include <iostream>
 
-int main() {
-    constexpr ScientificCalculator calc;
-    calc.run();
+#include "./src/calccore.hpp"
+
+// Most worker threads --threads accepts
+constexpr unsigned long long MAX_THREADS = 1024;
+
+// Read the value of a numeric option: decimal digits only, at most maximum
+// Returns false for a missing value and for anything else, such as "abc", "-1" or a value out of range
+static bool parseOptionValue(const char* text, const unsigned long long maximum, unsigned long long& value) {
+    if (text == nullptr) {
+        return false;
+    }
+    const char* end = text + strlen(text);
+    const auto [last, error] = std::from_chars(text, end, value);
+    return text != end && last == end && error == std::errc() && value <= maximum;
+}
+
+// Report a command line error, followed by the usage line
+static int usageError(const std::string& message) {
+    std::cerr << "Error: " << message << "\n"
+              << "Usage: Calculator [--batch [file] [--threads N] [--cache-size N] [--cache-stats] | --emit-cpp [file]]"
+              << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    // Batch mode: Calculator --batch [file] [--threads N] [--cache-size N] [--cache-stats]
+    // Reads standard input when no file (or "-") is given, --threads 0 uses every hardware thread
+    // Code generation: Calculator --emit-cpp [file] writes a C++ header for "name(x, y) = expression" lines
+    bool batch = false;
+    bool emitCpp = false;
+    bool cacheStats = false;
+    unsigned threads = 1;
+    std::string path = "-";
+    bool hasPath = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--batch") {
+            batch = true;
+        }
+        else if (arg == "--emit-cpp") {
+            emitCpp = true;
+        }
+        else if (arg == "--threads") {
+            unsigned long long value = 0;
+            if (!parseOptionValue(i + 1 < argc ? argv[++i] : nullptr, MAX_THREADS, value)) {
+                std::cerr << "Error: --threads expects a number from 0 to " << MAX_THREADS << std::endl;
+                return 1;
+            }
+            threads = static_cast<unsigned>(value);
+            if (threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+        }
+        else if (arg == "--cache-size") {
+            unsigned long long value = 0;
+            if (!parseOptionValue(i + 1 < argc ? argv[++i] : nullptr, std::numeric_limits<size_t>::max(), value)) {
+                std::cerr << "Error: --cache-size expects a number of entries" << std::endl;
+                return 1;
+            }
+            CalculatorEngine::setExpressionCacheSize(static_cast<size_t>(value));
+        }
+        else if (arg == "--cache-stats") {
+            cacheStats = true;
+        }
+        else if (arg.compare(0, 2, "--") == 0) {
+            return usageError("unknown option " + arg);
+        }
+        else if (hasPath) {
+            return usageError("unexpected argument " + arg);
+        }
+        else {
+            path = arg;
+            hasPath = true;
+        }
+    }
+
+    if (hasPath && !batch && !emitCpp) {
+        return usageError("a file is only read with --batch or --emit-cpp");
+    }
+
+    if (emitCpp) {
+        std::ifstream file;
+        if (path != "-") {
+            file.open(path);
+            if (!file) {
+                std::cerr << "Error: cannot open " << path << std::endl;
+                return 1;
+            }
+        }
+
+        try {
+            CalculatorEngine::emitCpp(path != "-" ? file : std::cin, std::cout);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (batch) {
+        std::ios::sync_with_stdio(false);
+
+        if (path != "-") {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                std::cerr << "Error: cannot open " << path << std::endl;
+                return 1;
+            }
+            CalculatorEngine::evaluateBatch(file, std::cout, threads);
+        }
+        else {
+            CalculatorEngine::evaluateBatch(std::cin, std::cout, threads);
+        }
+
+        if (cacheStats) {
+            const CacheStatistics statistics = CalculatorEngine::expressionCacheStatistics();
+            std::cerr << "Expression cache: " << statistics.hits << " hits, " << statistics.misses << " misses\n";
+        }
+
+        return 0;
+    }
+
+    CalculatorEngine::runInteractive();
 
     return 0;
 }
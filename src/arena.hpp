@@ -0,0 +1,119 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <new>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <algorithm>
+#include <memory_resource>
+
+// Arena: A bump allocator for the short-lived structures built while compiling an expression
+// Allocation advances a pointer through the current block and deallocation does nothing; reset()
+// makes all of the memory available again at once. Blocks are kept across resets, and when the
+// previous use needed more than one they are merged into a single block, so a long-running process
+// grows the arena to its high-water mark once and then stops asking the heap for memory.
+// Usable with any std::pmr container; not thread-safe, every thread needs its own.
+class Arena : public std::pmr::memory_resource {
+public:
+    // Size of the first block; later blocks double in size
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    explicit Arena(const size_t blockSize = DEFAULT_BLOCK_SIZE)
+        : blockSize_(blockSize)
+    {
+    }
+
+    ~Arena() override
+    {
+        release();
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Make all memory available again; nothing allocated before may be used afterwards
+    // Constant time unless the arena grew since the last reset
+    void reset()
+    {
+        if (blocks_.size() > 1)
+        {
+            const size_t total = capacity();
+            release();
+            addBlock(total);
+        }
+        used_ = 0;
+    }
+
+    // Total size of the blocks held, in bytes
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (const Block& block : blocks_)
+        {
+            total += block.size;
+        }
+        return total;
+    }
+
+private:
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+
+    void* do_allocate(const size_t bytes, const size_t alignment) override
+    {
+        if (!blocks_.empty())
+        {
+            void* position = blocks_.back().data + used_;
+            size_t space = blocks_.back().size - used_;
+            if (std::align(alignment, bytes, position, space) != nullptr)
+            {
+                used_ = static_cast<size_t>(static_cast<char*>(position) - blocks_.back().data) + bytes;
+                return position;
+            }
+        }
+
+        // Start a new block, at least twice the size of the last one and large enough for the request
+        const size_t size = std::max(bytes + alignment, blocks_.empty() ? blockSize_ : 2 * blocks_.back().size);
+        addBlock(size);
+        void* position = blocks_.back().data;
+        size_t space = size;
+        std::align(alignment, bytes, position, space);
+        used_ = static_cast<size_t>(static_cast<char*>(position) - blocks_.back().data) + bytes;
+        return position;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override
+    {
+        // Memory is only reclaimed by reset()
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
+
+    void addBlock(const size_t size)
+    {
+        blocks_.push_back({static_cast<char*>(::operator new(size)), size});
+        used_ = 0;
+    }
+
+    void release()
+    {
+        for (const Block& block : blocks_)
+        {
+            ::operator delete(block.data);
+        }
+        blocks_.clear();
+        used_ = 0;
+    }
+
+    std::vector<Block> blocks_;
+    size_t blockSize_;
+    size_t used_ = 0;
+};
@@ -0,0 +1,178 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#include <new>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+
+#include "calc.h"
+#include "calccore.hpp"
+
+struct calc_expression
+{
+    PreparedExpression prepared;
+    std::vector<double> values;
+};
+
+static_assert(static_cast<int>(ErrorKind::InvalidVariable) == CALC_INVALID_VARIABLE,
+              "calc_status must keep the numbering of ErrorKind");
+
+namespace {
+
+calc_status toStatus(const ErrorKind kind)
+{
+    return static_cast<calc_status>(kind);
+}
+
+// Run a C entry point, turning any exception into a status so none crosses the C boundary
+template<typename Function>
+calc_status guard(Function function)
+{
+    try {
+        return function();
+    }
+    catch (const std::bad_alloc&) {
+        return CALC_OUT_OF_MEMORY;
+    }
+    catch (const std::runtime_error&) {
+        return CALC_INVALID_EXPRESSION;
+    }
+    catch (const std::exception&) {
+        return CALC_INVALID_ARGUMENT;
+    }
+}
+
+} // namespace
+
+calc_status calc_prepare(const char* expression, const char* const* variables, const size_t variable_count,
+                         calc_expression** result, calc_error* error)
+{
+    if (result != nullptr)
+    {
+        *result = nullptr;
+    }
+    if (error != nullptr)
+    {
+        *error = {CALC_OK, 0, 0};
+    }
+
+    const calc_status status = guard([&] {
+        if (expression == nullptr || result == nullptr || (variables == nullptr && variable_count != 0))
+        {
+            return CALC_INVALID_ARGUMENT;
+        }
+
+        std::vector<std::string> names;
+        for (size_t k = 0; k < variable_count; ++k)
+        {
+            if (variables[k] == nullptr)
+            {
+                return CALC_INVALID_ARGUMENT;
+            }
+            names.emplace_back(variables[k]);
+        }
+
+        Result<PreparedExpression> prepared = CalculatorEngine::tryPrepare(expression, names);
+        if (!prepared)
+        {
+            if (error != nullptr)
+            {
+                *error = {toStatus(prepared.error().kind), prepared.error().position, prepared.error().length};
+            }
+            return toStatus(prepared.error().kind);
+        }
+
+        *result = new calc_expression{std::move(prepared).value(), std::vector<double>(variable_count, 0.0)};
+        return CALC_OK;
+    });
+
+    // Failures other than those of the expression have no position
+    if (error != nullptr && status != CALC_OK && error->status == CALC_OK)
+    {
+        *error = {status, 0, 0};
+    }
+    return status;
+}
+
+calc_status calc_bind(calc_expression* expression, const size_t slot, const double value)
+{
+    if (expression == nullptr || slot >= expression->values.size())
+    {
+        return CALC_INVALID_ARGUMENT;
+    }
+    expression->values[slot] = value;
+    return CALC_OK;
+}
+
+calc_status calc_eval(const calc_expression* expression, double* result)
+{
+    if (expression == nullptr || result == nullptr)
+    {
+        return CALC_INVALID_ARGUMENT;
+    }
+
+    return guard([&] {
+        const Result<double> value = expression->prepared.tryEvaluate(expression->values.data());
+        if (!value)
+        {
+            return toStatus(value.error().kind);
+        }
+        *result = value.value();
+        return CALC_OK;
+    });
+}
+
+calc_status calc_eval_batch(const calc_expression* expression, const double* const* columns, const size_t count,
+                            double* results)
+{
+    if (expression == nullptr || (results == nullptr && count != 0) ||
+        (columns == nullptr && !expression->values.empty()))
+    {
+        return CALC_INVALID_ARGUMENT;
+    }
+    for (size_t k = 0; k < expression->values.size(); ++k)
+    {
+        if (columns[k] == nullptr && count != 0)
+        {
+            return CALC_INVALID_ARGUMENT;
+        }
+    }
+
+    return guard([&] {
+        const Result<void> evaluated = expression->prepared.tryEvaluateColumns(columns, count, results);
+        return evaluated ? CALC_OK : toStatus(evaluated.error().kind);
+    });
+}
+
+void calc_free(calc_expression* expression)
+{
+    delete expression;
+}
+
+const char* calc_status_message(const calc_status status)
+{
+    switch (status)
+    {
+        case CALC_OK:
+            return "OK";
+        case CALC_INVALID_EXPRESSION:
+            return "Invalid expression";
+        case CALC_INVALID_NUMBER:
+            return "Invalid number format in expression";
+        case CALC_NUMBER_OUT_OF_RANGE:
+            return "Number out of range in expression";
+        case CALC_UNKNOWN_IDENTIFIER:
+            return "Unknown identifier in expression";
+        case CALC_DIVIDE_BY_ZERO:
+            return "Divide by zero";
+        case CALC_INVALID_VARIABLE:
+            return "Invalid variable name";
+        case CALC_INVALID_ARGUMENT:
+            return "Invalid argument";
+        case CALC_OUT_OF_MEMORY:
+            return "Out of memory";
+        default:
+            return "Unknown status";
+    }
+}
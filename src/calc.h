@@ -0,0 +1,68 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <stddef.h>
+
+// C interface of the calccore library, usable from C and through any foreign function interface
+// An expression is prepared once from its text; after that, binding variables and evaluating only
+// pass numbers. No function lets a C++ exception escape, every failure is reported as a calc_status.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A prepared expression together with the values bound to its variables
+typedef struct calc_expression calc_expression;
+
+// Result of every call; the error codes up to CALC_INVALID_VARIABLE are those of the calculator
+typedef enum calc_status
+{
+    CALC_OK = 0,
+    CALC_INVALID_EXPRESSION = 1,
+    CALC_INVALID_NUMBER = 2,
+    CALC_NUMBER_OUT_OF_RANGE = 3,
+    CALC_UNKNOWN_IDENTIFIER = 4,
+    CALC_DIVIDE_BY_ZERO = 5,
+    CALC_INVALID_VARIABLE = 6,
+    CALC_INVALID_ARGUMENT = 7,
+    CALC_OUT_OF_MEMORY = 8
+} calc_status;
+
+// Where a calc_prepare error was found: the offending number or name, or the whole expression
+// For CALC_INVALID_VARIABLE, position is the index of the variable name and length is 0
+typedef struct calc_error
+{
+    calc_status status;
+    size_t position;
+    size_t length;
+} calc_error;
+
+// Compile a NUL-terminated expression whose variables are named by variables[0 .. variable_count - 1]
+// The names must be distinct identifiers other than pi and e, else CALC_INVALID_VARIABLE is returned.
+// On success *result receives a new handle with every variable bound to 0; release it with calc_free.
+// On failure *result is set to NULL and, when error is not NULL, the error is located in *error.
+calc_status calc_prepare(const char* expression, const char* const* variables, size_t variable_count,
+                         calc_expression** result, calc_error* error);
+
+// Bind the variable at position slot to value until it is bound again
+calc_status calc_bind(calc_expression* expression, size_t slot, double value);
+
+// Evaluate with the bound values and store the value in *result
+// A handle may be evaluated from several threads at once, but not while it is being bound
+calc_status calc_eval(const calc_expression* expression, double* result);
+
+// Evaluate count rows: columns[k] points to count values of variable k, results to count doubles
+// When any row divides by zero, CALC_DIVIDE_BY_ZERO is returned and results are unspecified
+calc_status calc_eval_batch(const calc_expression* expression, const double* const* columns, size_t count,
+                            double* results);
+
+// Release a handle; NULL is ignored
+void calc_free(calc_expression* expression);
+
+// A static, human-readable description of a status
+const char* calc_status_message(calc_status status);
+
+#ifdef __cplusplus
+}
+#endif
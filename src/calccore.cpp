@@ -0,0 +1,102 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#include <utility>
+
+#include "calccore.hpp"
+#include "calculator.hpp"
+#include "jit.hpp"
+#include "codegen.hpp"
+
+PreparedExpression::PreparedExpression(std::shared_ptr<const JitExpression> compiled)
+    : compiled_(std::move(compiled))
+{
+}
+
+double PreparedExpression::evaluate(const std::vector<double>& values) const
+{
+    return compiled_->evaluate(values);
+}
+
+Result<double> PreparedExpression::tryEvaluate(const double* values) const
+{
+    return compiled_->tryEvaluate(values);
+}
+
+void PreparedExpression::evaluateColumns(const double* const* columns, const std::size_t count, double* results) const
+{
+    compiled_->expression().evaluateColumns(columns, count, results);
+}
+
+Result<void> PreparedExpression::tryEvaluateColumns(const double* const* columns, const std::size_t count,
+                                                    double* results) const
+{
+    return compiled_->expression().tryEvaluateColumns(columns, count, results);
+}
+
+std::size_t PreparedExpression::variableCount() const
+{
+    return compiled_->expression().variableCount();
+}
+
+PreparedExpression CalculatorEngine::prepare(const std::string_view expression,
+                                             const std::vector<std::string>& variables)
+{
+    return PreparedExpression(
+        std::make_shared<const JitExpression>(ScientificCalculator::compile(expression, variables)));
+}
+
+Result<PreparedExpression> CalculatorEngine::tryPrepare(const std::string_view expression,
+                                                        const std::vector<std::string>& variables)
+{
+    Result<CompiledExpression> compiled = ScientificCalculator::tryCompile(expression, variables);
+    if (!compiled)
+    {
+        return compiled.error();
+    }
+    return PreparedExpression(std::make_shared<const JitExpression>(std::move(compiled).value()));
+}
+
+double CalculatorEngine::evaluate(const std::string_view expression)
+{
+    const Result<double> result = tryEvaluate(expression);
+    if (!result)
+    {
+        throwError(result.error(), expression);
+    }
+    return result.value();
+}
+
+Result<double> CalculatorEngine::tryEvaluate(const std::string_view expression)
+{
+    return ScientificCalculator::Evaluator::local().evaluate(expression);
+}
+
+bool CalculatorEngine::evaluateInteger(const std::string_view expression, long long& result)
+{
+    return ScientificCalculator::Evaluator::local().evaluateInteger(expression, result);
+}
+
+void CalculatorEngine::evaluateBatch(std::istream& in, std::ostream& out, const unsigned threads)
+{
+    ScientificCalculator().runBatch(in, out, threads);
+}
+
+void CalculatorEngine::runInteractive()
+{
+    ScientificCalculator().run();
+}
+
+void CalculatorEngine::setExpressionCacheSize(const std::size_t entries)
+{
+    ScientificCalculator::expressionCacheSize = entries;
+}
+
+CacheStatistics CalculatorEngine::expressionCacheStatistics()
+{
+    return ScientificCalculator::expressionCacheStatistics();
+}
+
+void CalculatorEngine::emitCpp(std::istream& in, std::ostream& out)
+{
+    CppEmitter::emit(in, out);
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <iosfwd>
+#include <string_view>
+
+#include "result.hpp"
+
+class JitExpression;
+
+// Public interface of the calccore library, for linking the calculator engine into other programs
+// Only this header and result.hpp are needed to use it; the engine itself is compiled into the library.
+// Every function may be called from any thread: caches and scratch memory are kept per thread.
+
+// PreparedExpression: An expression compiled once and evaluated any number of times
+// Variables are bound by position, in the order their names were given to CalculatorEngine::prepare
+// Copies are cheap and share the compiled program, which is immutable
+// Single evaluations run native code where JitExpression supports the platform and the expression
+class PreparedExpression {
+public:
+    // Evaluate with one value per variable
+    // Throws std::invalid_argument for a wrong number of values and std::runtime_error("Divide by zero")
+    double evaluate(const std::vector<double>& values = {}) const;
+
+    // Non-throwing evaluation with values pointing to one value per variable
+    // Returns ErrorKind::DivideByZero instead of throwing
+    Result<double> tryEvaluate(const double* values) const;
+
+    // Evaluate over whole input arrays: columns[k] holds count values of the k-th variable
+    // Throws std::runtime_error("Divide by zero") when any row divides by zero
+    void evaluateColumns(const double* const* columns, std::size_t count, double* results) const;
+
+    // Non-throwing evaluateColumns: ErrorKind::DivideByZero when any row divides by zero
+    Result<void> tryEvaluateColumns(const double* const* columns, std::size_t count, double* results) const;
+
+    // Number of variables the expression was prepared with
+    std::size_t variableCount() const;
+
+private:
+    friend class CalculatorEngine;
+
+    explicit PreparedExpression(std::shared_ptr<const JitExpression> compiled);
+
+    std::shared_ptr<const JitExpression> compiled_;
+};
+
+// CalculatorEngine: Entry points of the calccore library
+class CalculatorEngine {
+public:
+    // Compile an expression with the given variable names
+    // Throws std::invalid_argument or std::runtime_error like ScientificCalculator::compile
+    static PreparedExpression prepare(std::string_view expression, const std::vector<std::string>& variables = {});
+
+    // Non-throwing prepare: the prepared expression, or the kind and position of the first error
+    static Result<PreparedExpression> tryPrepare(std::string_view expression,
+                                                 const std::vector<std::string>& variables = {});
+
+    // Evaluate an expression without variables once, with the calling thread's scratch buffers and
+    // without compiling it; prepare expressions that are evaluated repeatedly
+    // Throws the same exceptions as ScientificCalculator::compile and evaluation
+    static double evaluate(std::string_view expression);
+
+    // Non-throwing evaluate: the value, or the kind and position of the first error
+    static Result<double> tryEvaluate(std::string_view expression);
+
+    // Evaluate pure integer arithmetic exactly in 64 bits
+    // Returns false when the expression needs floating point evaluation, see evaluate
+    static bool evaluateInteger(std::string_view expression, long long& result);
+
+    // Batch mode: one result or "Error: <message>" line per input line, see ScientificCalculator::runBatch
+    static void evaluateBatch(std::istream& in, std::ostream& out, unsigned threads = 1);
+
+    // Interactive mode on standard input and output, see ScientificCalculator::run
+    static void runInteractive();
+
+    // Number of compiled expressions kept by each thread's expression cache, default 4096
+    // Takes effect for caches created after the change, so set it before the first evaluation
+    static void setExpressionCacheSize(std::size_t entries);
+
+    // Hit and miss counts of the expression caches of all threads
+    static CacheStatistics expressionCacheStatistics();
+
+    // Write a C++ header for "name(x, y) = expression" lines, see CppEmitter::emit
+    static void emitCpp(std::istream& in, std::ostream& out);
+};
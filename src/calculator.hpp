@@ -2,14 +2,24 @@
 
 #pragma once
 
-#include <stack>
-#include <queue>
-#include <cmath>
 #include <string>
+#include <vector>
+#include <cstring>
+#include <string_view>
+#include <charconv>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
 #include <algorithm>
 
+#include "arena.hpp"
+#include "result.hpp"
+#include "postfix.hpp"
+#include "optimizer.hpp"
+#include "lru_cache.hpp"
+#include "parallel_batch.hpp"
+#include "compiled_expression.hpp"
+
 // ScientificCalculator: A class that implements a command-line scientific calculator
 // Supports basic arithmetic operations, constants, and expression evaluation
 class ScientificCalculator {
@@ -32,28 +42,27 @@ public:
             try {
                 // Prompt for user input
                 std::cout << "\nEnter expression or command: ";
-                getline(std::cin, input);
-
-                // Delete all the whitespaces
-                input.erase(std::remove(input.begin(), input.end(), ' '), input.end());
+                if (!getline(std::cin, input)) {
+                    break;
+                }
 
                 // Check for quit command
-                if (input == "q" || input == "Q") {
+                const std::string_view command = trim(input);
+                if (command == "q" || command == "Q") {
                     running = false;
                     continue;
                 }
 
-                // Replace mathematical constants with their numeric values
-                size_t pos;
-                while ((pos = input.find("pi")) != std::string::npos) {
-                    input.replace(pos, 2, std::to_string(PI));
-                }
-                while ((pos = input.find('e')) != std::string::npos) {
-                    input.replace(pos, 1, std::to_string(E));
+                // Integer arithmetic is shown exactly
+                long long exact = 0;
+                if (Evaluator::local().evaluateInteger(input, exact)) {
+                    std::cout << "Result: " << exact << std::endl;
+                    continue;
                 }
 
                 // Evaluate the input expression and display the result
-                double result = evaluateExpression(input);
+                // A typed expression is seen once, so it is evaluated while parsing instead of compiled
+                double result = evaluateDirect(input);
                 std::cout << "Result: " << result << std::endl;
             }
             catch (const std::exception& e) {
@@ -63,24 +72,591 @@ public:
         }
     }
 
+    // Non-interactive batch mode: evaluate one expression per input line
+    // Writes one result or error per line without prompts, collected in a large buffer and written in bulk
+    // With more than one thread the lines are evaluated by the parallel pipeline, output order is unchanged
+    void runBatch(std::istream& in, std::ostream& out, const unsigned threads = 1) const {
+        if (threads > 1) {
+            ParallelBatch::run(in, out, threads, evaluateBatchLine);
+            return;
+        }
+
+        std::string buffer;
+        std::string output;
+        std::string pending;
+        buffer.resize(BATCH_BUFFER_SIZE);
+        output.reserve(BATCH_BUFFER_SIZE + 256);
+
+        while (in) {
+            in.read(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+            const size_t length = static_cast<size_t>(in.gcount());
+            size_t start = 0;
+
+            // Process every complete line in the block, keep the tail for the next block
+            const char* newline;
+            while ((newline = static_cast<const char*>(memchr(buffer.data() + start, '\n', length - start))) != nullptr)
+            {
+                const size_t end = newline - buffer.data();
+                if (pending.empty()) {
+                    evaluateBatchLine(std::string_view(buffer.data() + start, end - start), output);
+                }
+                else {
+                    pending.append(buffer, start, end - start);
+                    evaluateBatchLine(pending, output);
+                    pending.clear();
+                }
+                start = end + 1;
+
+                if (output.size() >= BATCH_BUFFER_SIZE) {
+                    out.write(output.data(), static_cast<std::streamsize>(output.size()));
+                    output.clear();
+                }
+            }
+            pending.append(buffer, start, length - start);
+        }
+
+        // The last line may not end with a newline
+        if (!pending.empty()) {
+            evaluateBatchLine(pending, output);
+        }
+        out.write(output.data(), static_cast<std::streamsize>(output.size()));
+        out.flush();
+    }
+
+    // Number of compiled expressions kept by each thread's expression cache
+    // Takes effect for caches created after the change, so set it before starting a batch
+    static inline size_t expressionCacheSize = 4096;
+
+    // Hit and miss counts of the expression caches of all threads
+    static CacheStatistics expressionCacheStatistics()
+    {
+        return LruCache<std::string, CompiledExpression>::totalStatistics();
+    }
+
+    // Evaluator: Working memory for evaluating expressions one after another
+    // Owns the token buffer and the operator and operand stacks used by translateToPostfix and evaluation,
+    // the key buffer of the expression cache and the arena that compiling allocates from. They keep their
+    // capacity between calls, so once they have grown to fit the longest expression seen, evaluation
+    // allocates nothing.
+    // An Evaluator must not be shared between threads; local() returns the calling thread's own.
+    class Evaluator {
+    public:
+        // Evaluate an expression without variables straight from its postfix program, without
+        // compiling or caching it. Results and errors are the same as those of tryEvaluate.
+        Result<double> evaluate(const std::string_view expression)
+        {
+            if (const EvaluationError error = translateToPostfix(expression, {}, tokens_, operators_))
+            {
+                return error;
+            }
+            if (!isWellFormed(tokens_))
+            {
+                return EvaluationError{ErrorKind::InvalidExpression, 0, expression.length()};
+            }
+
+            operands_.clear();
+            for (const Token& token : tokens_)
+            {
+                if (token.op == OpCode::Number)
+                {
+                    operands_.push_back(token.value);
+                    continue;
+                }
+
+                const double b = operands_.back();
+                operands_.pop_back();
+                if (token.op == OpCode::Divide && b == 0)
+                {
+                    return EvaluationError{ErrorKind::DivideByZero, 0, expression.length()};
+                }
+                operands_.back() = calculate(operands_.back(), b, token.op);
+            }
+            return operands_.back();
+        }
+
+        // Evaluate pure integer arithmetic exactly in 64 bits
+        // Applies when every literal is an integer and there is no '/', name or exponent notation; returns
+        // false when the expression needs double evaluation, including on overflow or a negative exponent
+        bool evaluateInteger(const std::string_view expression, long long& result)
+        {
+            // Cheap scan first, so that other expressions are not lexed twice
+            for (const char c : expression)
+            {
+                if (c == '.' || c == '/' || isAlpha(c) || c == '_')
+                {
+                    return false;
+                }
+            }
+
+            return !translateToPostfix(expression, {}, tokens_, operators_) &&
+                   evaluateIntegerPostfix(tokens_, result);
+        }
+
+        // The calling thread's evaluator, used by batch mode and the interactive interface
+        static Evaluator& local()
+        {
+            thread_local Evaluator evaluator;
+            return evaluator;
+        }
+
+    private:
+        friend class ScientificCalculator;
+
+        std::vector<Token> tokens_;
+        std::vector<char> operators_;
+        std::vector<double> operands_;
+        std::string key_;
+        Arena arena_;
+    };
+
+    // Compile an expression once so it can be evaluated repeatedly
+    // Lexing and the Shunting Yard translation are paid only here, not on every evaluation
+    // Names in variables may be used in the expression and are bound by position at evaluation time;
+    // they must be distinct identifiers other than pi and e, see isVariableName
+    // A polynomial in one variable is evaluated in Horner form
+    static CompiledExpression compile(const std::string_view expression, const std::vector<std::string>& variables = {})
+    {
+        Result<CompiledExpression> result = tryCompile(expression, variables);
+        if (!result)
+        {
+            throwError(result.error(), expression);
+        }
+        return std::move(result).value();
+    }
+
+    // Non-throwing compile: the compiled expression, or the kind and position of the first error
+    // The tokens go to the calling thread's Evaluator buffers and the expression tree and the working
+    // tables of code generation to its arena, which is reset here; only the result is on the heap
+    static Result<CompiledExpression> tryCompile(const std::string_view expression,
+                                                 const std::vector<std::string>& variables = {})
+    {
+        // A name that cannot be read from the expression, or one given twice, could never be bound
+        for (size_t k = 0; k < variables.size(); ++k)
+        {
+            if (!isVariableName(variables[k]) || std::count(variables.begin(), variables.end(), variables[k]) > 1)
+            {
+                return EvaluationError{ErrorKind::InvalidVariable, k, 0};
+            }
+        }
+
+        Evaluator& evaluator = Evaluator::local();
+        evaluator.arena_.reset();
+
+        std::vector<Token>& postfix = evaluator.tokens_;
+        if (const EvaluationError error = translateToPostfix(expression, variables, postfix, evaluator.operators_))
+        {
+            return error;
+        }
+        if (!isWellFormed(postfix))
+        {
+            return EvaluationError{ErrorKind::InvalidExpression, 0, expression.length()};
+        }
+
+        ExpressionTree tree = ExpressionTree::fromPostfix(postfix, &evaluator.arena_);
+        return CompiledExpression(rewritePolynomial(std::move(tree)), variables.size());
+    }
+
+    // Whether name can be used as a variable: an identifier other than the constants pi and e
+    static bool isVariableName(const std::string_view name)
+    {
+        if (name.empty() || isDigit(name.front()) || name == "pi" || name == "e")
+        {
+            return false;
+        }
+        return std::all_of(name.begin(), name.end(), isIdentifierChar);
+    }
+
+    // Non-throwing evaluation of an expression without variables, through the expression cache
+    // Malformed input and division by zero are reported as errors instead of exceptions
+    static Result<double> tryEvaluate(const std::string_view expression)
+    {
+        const Result<const CompiledExpression*> compiled = compileCached(expression);
+        if (!compiled)
+        {
+            return compiled.error();
+        }
+        return evaluateCompiled(*compiled.value(), expression);
+    }
+
+    // Evaluate a constant expression; folds at compile time when used in a constant expression,
+    // e.g. constexpr double area = ScientificCalculator::eval("2*(3+pi)")
+    // Runs the Shunting Yard translation of translateToPostfix, but applies each operator as soon as it is
+    // emitted, so no postfix program is built. Only pi and e may be used as names.
+    // Any error, including a division by zero, makes a compile-time evaluation ill-formed; at run time the
+    // expression is handed to evaluateExpression, so there is no nesting limit and the exceptions and messages
+    // are those of compile and evaluation. Numbers convert like std::from_chars, see parseNumber for the
+    // exceptions in constant expressions.
+    static constexpr double eval(const std::string_view expression)
+    {
+        if (!isConstantEvaluated())
+        {
+            return evaluateExpression(expression);
+        }
+
+        ConstantStack<char> operations;
+        ConstantEvaluation values;
+        if (const EvaluationError error = shuntingYard(expression, nullptr, values, operations))
+        {
+            throwError(error, expression);
+        }
+        if (const EvaluationError error = values.error(expression.length()))
+        {
+            throwError(error, expression);
+        }
+        return values.operands.back();
+    }
+
 private:
     // Mathematical constants
-    const double PI = 3.14159265358979323846;
-    const double E = 2.71828182845904523536;
+    static constexpr double PI = 3.14159265358979323846;
+    static constexpr double E = 2.71828182845904523536;
+
+    // Capacity of the operator and operand stacks of eval in constant expressions
+    static constexpr size_t CONSTANT_STACK_SIZE = 64;
+
+    // Size of the input blocks and of the output buffer used by batch mode
+    static constexpr size_t BATCH_BUFFER_SIZE = 1 << 20;
+
+    // Evaluate a single batch line and append its result or error message to the output buffer
+    static void evaluateBatchLine(const std::string_view line, std::string& output)
+    {
+        // Errors are expected in batch data, so they are reported without throwing
+        try {
+            long long exact = 0;
+            if (Evaluator::local().evaluateInteger(line, exact))
+            {
+                appendInteger(exact, output);
+            }
+            else if (const Result<double> result = tryEvaluate(line))
+            {
+                appendNumber(result.value(), output);
+            }
+            else
+            {
+                output += "Error: ";
+                output += errorMessage(result.error(), line);
+            }
+        }
+        catch (const std::exception& e) {
+            output += "Error: ";
+            output += e.what();
+        }
+        output += '\n';
+    }
+
+    // Append a number to the output buffer, formatted like std::cout with its default precision
+    static void appendNumber(const double value, std::string& output)
+    {
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::general, 6);
+        output.append(digits, result.ptr);
+    }
+
+    // Append an exact integer result to the output buffer
+    static void appendInteger(const long long value, std::string& output)
+    {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        output.append(digits, result.ptr);
+    }
+
+    // Build the expression cache key in key: the input without whitespace
+    // A single space is kept where removing it would join two numbers or names into one token, and
+    // between a '-' and a number: "--2" negates -2, but in "-- 2" the second '-' starts a malformed number.
+    // Around the sign of an exponent spacing decides the meaning too: "1e-3" is 0.001, while in "1e -3"
+    // and "1e- 3" the number ends before the 'e', which is the constant e. So a space is also kept
+    // between an 'e' or 'E' and a sign, and after a sign that follows an 'e' or 'E'.
+    static void normalizeExpression(const std::string_view input, std::string& key)
+    {
+        key.clear();
+
+        bool pendingSpace = false;
+        for (const char c : input)
+        {
+            if (isSpace(c))
+            {
+                pendingSpace = !key.empty();
+                continue;
+            }
+            if (pendingSpace && isSignificantSpace(key, c))
+            {
+                key += ' ';
+            }
+            pendingSpace = false;
+            key += c;
+        }
+    }
+
+    // Whether whitespace between the non-empty key and the character c changes how the input is lexed
+    static bool isSignificantSpace(const std::string& key, const char c)
+    {
+        const char last = key.back();
+        const bool afterExponent = key.length() >= 2 && (key[key.length() - 2] == 'e' || key[key.length() - 2] == 'E');
+        if ((last == '+' || last == '-') && afterExponent)
+        {
+            return true;
+        }
+        if ((c == '+' || c == '-') && (last == 'e' || last == 'E'))
+        {
+            return true;
+        }
+        return (isIdentifierChar(c) || c == '.') && (isIdentifierChar(last) || last == '.' || last == '-');
+    }
+
+    // Strip leading and trailing whitespace without copying
+    static std::string_view trim(std::string_view input)
+    {
+        while (!input.empty() && isspace(static_cast<unsigned char>(input.front())))
+        {
+            input.remove_prefix(1);
+        }
+        while (!input.empty() && isspace(static_cast<unsigned char>(input.back())))
+        {
+            input.remove_suffix(1);
+        }
+        return input;
+    }
 
     // Check if a character is a valid mathematical operator
     // Supports addition, subtraction, multiplication, division, and exponentiation
-    static bool isOperator(const char c)
+    static constexpr bool isOperator(const char c)
     {
         return (c == '+' || c == '-' || c == '*' || c == '/' || c == '^');
     }
 
+    // Character classes of the lexer, the same as the C locale's but usable in constant expressions
+    static constexpr bool isSpace(const char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    static constexpr bool isDigit(const char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static constexpr bool isAlpha(const char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    // Check if a character can be part of an identifier (variable or constant name)
+    static constexpr bool isIdentifierChar(const char c)
+    {
+        return isAlpha(c) || isDigit(c) || c == '_';
+    }
+
+    // Read the identifier starting at position i into token and leave i on its last character
+    // pi and e resolve to their numeric values, other names must be one of the variables, if any
+    static constexpr EvaluationError readIdentifier(const std::string_view expression, size_t& i,
+                                                    const std::vector<std::string>* variables, Token& token)
+    {
+        const size_t start = i;
+        while (i + 1 < expression.length() && isIdentifierChar(expression[i + 1]))
+        {
+            ++i;
+        }
+        const std::string_view name = expression.substr(start, i - start + 1);
+
+        if (name == "pi")
+        {
+            token = {OpCode::Number, 0, PI};
+            return {};
+        }
+        if (name == "e")
+        {
+            token = {OpCode::Number, 0, E};
+            return {};
+        }
+
+        if (variables == nullptr)
+        {
+            return {ErrorKind::UnknownIdentifier, start, name.length()};
+        }
+        const auto found = std::find(variables->begin(), variables->end(), name);
+        if (found == variables->end())
+        {
+            return {ErrorKind::UnknownIdentifier, start, name.length()};
+        }
+        token = {OpCode::Variable, static_cast<unsigned>(found - variables->begin()), 0.0};
+        return {};
+    }
+
+    // Parse the number starting at position i straight from the input buffer, locale-independent
+    // Accepts decimals and scientific notation such as 1.5e-9; a second '.' ends the number
+    // negative applies a unary minus that was already consumed; i is left on the last character
+    // A digit or '.' must follow the optional '-', so the inf and nan spellings of from_chars are rejected
+    // std::from_chars cannot be called in constant expressions, where convertNumber is used instead
+    static constexpr EvaluationError parseNumber(const std::string_view expression, size_t& i, const bool negative,
+                                                 double& number)
+    {
+        const size_t digits = i < expression.length() && expression[i] == '-' ? i + 1 : i;
+        if (digits == expression.length() || !(isDigit(expression[digits]) || expression[digits] == '.'))
+        {
+            return invalidNumber(expression, i, negative);
+        }
+        if (isConstantEvaluated())
+        {
+            return convertNumber(expression, i, negative, number);
+        }
+
+        const char* first = expression.data() + i;
+        const char* last = expression.data() + expression.length();
+        const std::from_chars_result result = std::from_chars(first, last, number, std::chars_format::general);
+        if (result.ec == std::errc::result_out_of_range)
+        {
+            return {ErrorKind::NumberOutOfRange, i, static_cast<size_t>(result.ptr - first), negative};
+        }
+        if (result.ec != std::errc())
+        {
+            return invalidNumber(expression, i, negative);
+        }
+
+        i = static_cast<size_t>(result.ptr - expression.data()) - 1;
+        number = negative ? -number : number;
+        return {};
+    }
+
+    // The error for a malformed number at position i, which spans the digits and '.' found there
+    static constexpr EvaluationError invalidNumber(const std::string_view expression, const size_t i,
+                                                   const bool negative)
+    {
+        size_t length = 0;
+        while (i + length < expression.length() && (isDigit(expression[i + length]) || expression[i + length] == '.'))
+        {
+            ++length;
+        }
+        return {ErrorKind::InvalidNumber, i, length, negative};
+    }
+
+    // parseNumber for constant expressions, accepting the same forms as std::from_chars in general format
+    // When the significant digits fit in the 53 bits of a double and the decimal exponent is within 22,
+    // both the digits and the power of ten are exact doubles and the value is rounded once, by a single
+    // multiplication or division, so it is exactly the value from_chars gives. Other numbers are scaled in
+    // long double and may differ from from_chars in the last bit.
+    static constexpr EvaluationError convertNumber(const std::string_view expression, size_t& i, const bool negative,
+                                                   double& number)
+    {
+        const size_t start = i;
+        const bool minus = expression[i] == '-';
+        if (minus)
+        {
+            ++i;
+        }
+        unsigned long long mantissa = 0;
+        int exponent = 0;
+        bool anyDigit = false;
+        bool exact = true;
+
+        // Keep up to 19 significant digits, later integer digits only scale the value
+        const auto digit = [&](const char c, const bool fraction) {
+            if (mantissa < 1000000000000000000ULL)
+            {
+                mantissa = mantissa * 10 + static_cast<unsigned>(c - '0');
+                exponent -= fraction ? 1 : 0;
+            }
+            else
+            {
+                exponent += fraction ? 0 : 1;
+                exact = exact && c == '0';
+            }
+            anyDigit = true;
+        };
+
+        while (i < expression.length() && isDigit(expression[i]))
+        {
+            digit(expression[i++], false);
+        }
+        if (i < expression.length() && expression[i] == '.')
+        {
+            ++i;
+            while (i < expression.length() && isDigit(expression[i]))
+            {
+                digit(expression[i++], true);
+            }
+        }
+
+        if (!anyDigit)
+        {
+            return invalidNumber(expression, start, negative);
+        }
+
+        // The exponent part only counts when at least one digit follows the 'e' and its sign
+        if (i < expression.length() && (expression[i] == 'e' || expression[i] == 'E'))
+        {
+            size_t j = i + 1;
+            const bool negativeExponent = j < expression.length() && expression[j] == '-';
+            if (j < expression.length() && (expression[j] == '-' || expression[j] == '+'))
+            {
+                ++j;
+            }
+            if (j < expression.length() && isDigit(expression[j]))
+            {
+                int value = 0;
+                for (; j < expression.length() && isDigit(expression[j]); ++j)
+                {
+                    value = std::min(value * 10 + (expression[j] - '0'), 100000);
+                }
+                exponent += negativeExponent ? -value : value;
+                i = j;
+            }
+        }
+
+        double value = 0.0;
+        if (exact && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+        {
+            double scale = 1.0;
+            for (int k = 0; k < (exponent < 0 ? -exponent : exponent); ++k)
+            {
+                scale *= 10.0;
+            }
+            value = exponent < 0 ? static_cast<double>(mantissa) / scale : static_cast<double>(mantissa) * scale;
+        }
+        else
+        {
+            long double scaled = static_cast<long double>(mantissa);
+            for (; exponent > 22; exponent -= 22)
+            {
+                scaled *= 1e22L;
+            }
+            for (; exponent < -22; exponent += 22)
+            {
+                scaled /= 1e22L;
+            }
+            long double scale = 1.0L;
+            for (int k = 0; k < (exponent < 0 ? -exponent : exponent); ++k)
+            {
+                scale *= 10.0L;
+            }
+            value = static_cast<double>(exponent < 0 ? scaled / scale : scaled * scale);
+        }
+
+        if (value > std::numeric_limits<double>::max() || (value == 0 && mantissa != 0))
+        {
+            return {ErrorKind::NumberOutOfRange, start, i - start, negative};
+        }
+
+        --i; // Leave i on the last character
+        number = negative != minus ? -value : value;
+        return {};
+    }
+
+    // Whether the caller is being evaluated in a constant expression
+    static constexpr bool isConstantEvaluated()
+    {
+#if defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1925)
+        return __builtin_is_constant_evaluated();
+#else
+        return false;
+#endif
+    }
+
     // Determine the precedence of mathematical operators
     // Higher precedence means the operator is evaluated first
     // ^ (exponentiation) has the highest precedence
     // * and / have medium precedence
     // + and - have the lowest precedence
-    static int getPrecedence(const char op)
+    static constexpr int getPrecedence(const char op)
     {
         if (op == '^')
         {
@@ -98,91 +674,143 @@ private:
         return 0;
     }
 
-    // Perform calculation based on the given operator
-    // Supports addition, subtraction, multiplication, division, and exponentiation
-    // Includes error handling for division by zero
-    static double calculate(const double a, const double b, const char op)
+    // Map an operator character to its operation code
+    static constexpr OpCode toOpCode(const char op)
     {
         switch (op)
         {
             case '+':
-                return a + b;
+                return OpCode::Add;
             case '-':
-                return a - b;
+                return OpCode::Subtract;
             case '*':
-                return a * b;
+                return OpCode::Multiply;
             case '/':
-                if (b == 0)
-                {
-                    throw std::runtime_error("Divide by zero");
-                }
-                return a / b;
+                return OpCode::Divide;
             case '^':
-                return pow(a, b);
+                return OpCode::Power;
             default:
                 throw std::runtime_error("Invalid operator");
         }
     }
 
+    // Kind of the previously read token
+    // Decides between unary and binary minus and where an implicit multiplication is inserted
+    enum class Previous
+    {
+        None,
+        Operand,
+        Operator,
+        OpenParen,
+        CloseParen
+    };
+
     // Convert infix expression to postfix notation (Shunting Yard algorithm)
     // This allows for proper handling of operator precedence and parentheses
-    static std::queue<std::string> translateToPostfix(const std::string& expression) {
-        std::stack<char> operations;
-        std::queue<std::string> values;
+    // Numbers are parsed once here and emitted as typed tokens, identifiers as constants or variable slots
+    // Single pass over the input: whitespace only separates tokens and nothing is copied or rewritten
+    // Non-throwing translation into values; operations is the operator stack
+    // Both are cleared first and only grow, so buffers reused across calls stop allocating
+    static EvaluationError translateToPostfix(const std::string_view expression,
+                                              const std::vector<std::string>& variables, std::vector<Token>& values,
+                                              std::vector<char>& operations) {
+        operations.clear();
+        values.clear();
+        values.reserve(expression.length());
+        return shuntingYard(expression, &variables, values, operations);
+    }
+
+    // The Shunting Yard translation shared by translateToPostfix and eval
+    // Emits every token with values.push_back, so values may evaluate them instead of storing them;
+    // operations needs push_back, back, pop_back and empty. Without variables only pi and e are names.
+    template<typename Values, typename Operations>
+    static constexpr EvaluationError shuntingYard(const std::string_view expression,
+                                                  const std::vector<std::string>* variables, Values& values,
+                                                  Operations& operations) {
+        Previous previous = Previous::None;
 
         for (size_t i = 0; i < expression.length(); i++)
         {
+            // Whitespace only separates tokens
+            if (isSpace(expression[i]))
+            {
+                continue;
+            }
 
             // Handle multi-digit numbers and decimal numbers
-            if (isdigit(expression[i]) || expression[i] == '.' ||
-                (expression[i] == '-' && (i == 0 || (!isdigit(expression[i - 1]) && expression[i - 1] != ')'))))
+            // A '-' that does not follow an operand or ')' is a unary minus and belongs to the number
+            if (isDigit(expression[i]) || expression[i] == '.' ||
+                (expression[i] == '-' && previous != Previous::Operand && previous != Previous::CloseParen))
             {
-                std::string num;
-                if (expression[i] == '-')
+                // Check for implicit multiplication: (2)3 -> (2)*3
+                if (previous == Previous::CloseParen)
                 {
-                    // Include '-' and move to the next character
-                    num += expression[i++];
+                    operations.push_back('*');
                 }
+                previous = Previous::Operand;
 
-                // Track decimal points to ensure validity
-                bool hasDecimal = false;
-
-                while (i < expression.length() && (isdigit(expression[i]) || expression[i] == '.'))
+                bool negative = false;
+                if (expression[i] == '-')
                 {
-                    if (expression[i] == '.')
+                    // Skip '-' and any whitespace after it
+                    negative = true;
+                    ++i;
+                    while (i < expression.length() && isSpace(expression[i]))
                     {
-                        // Stop if more than one decimal point
-                        if (hasDecimal) {
-                            break;
-                        }
-
-                        // Mark that a decimal point was found
-                        hasDecimal = true;
+                        ++i;
                     }
 
-                    num += expression[i++];
+                    // Negated identifier: -x -> x * -1, bound as tightly as a negative literal
+                    if (i < expression.length() && (isAlpha(expression[i]) || expression[i] == '_'))
+                    {
+                        Token token{};
+                        if (const EvaluationError error = readIdentifier(expression, i, variables, token))
+                        {
+                            return error;
+                        }
+                        values.push_back(token);
+                        values.push_back({OpCode::Number, 0, -1.0});
+                        values.push_back({OpCode::Multiply, 0, 0.0});
+                        continue;
+                    }
                 }
 
                 // Push valid number to the stack
-                if (!num.empty() && (num != "-" && num != "." && num != "-."))
+                double number = 0.0;
+                if (const EvaluationError error = parseNumber(expression, i, negative, number))
                 {
-                    values.push(num);
+                    return error;
                 }
-                else
+                values.push_back({OpCode::Number, 0, number});
+            }
+
+            // Handle constants and variables
+            else if (isAlpha(expression[i]) || expression[i] == '_')
+            {
+                // Check for implicit multiplication: 2x -> 2*x, (2)x -> (2)*x
+                if (previous == Previous::Operand || previous == Previous::CloseParen)
                 {
-                    throw std::invalid_argument("Invalid number format in expression: " + num);
+                    operations.push_back('*');
                 }
-                --i; // Adjust for the extra increment
+                Token token{};
+                if (const EvaluationError error = readIdentifier(expression, i, variables, token))
+                {
+                    return error;
+                }
+                values.push_back(token);
+                previous = Previous::Operand;
             }
 
             // Handle opening parenthesis
             else if (expression[i] == '(')
             {
-                if (isdigit(expression[i - 1]))
+                // Check for implicit multiplication: 2(3) -> 2*(3), (2)(3) -> (2)*(3)
+                if (previous == Previous::Operand || previous == Previous::CloseParen)
                 {
-                    operations.push('*');
+                    operations.push_back('*');
                 }
-                operations.push(expression[i]);
+                operations.push_back(expression[i]);
+                previous = Previous::OpenParen;
             }
 
             // Handle closing parenthesis
@@ -190,35 +818,31 @@ private:
             else if (expression[i] == ')')
             {
                 // Process all operators until we find the matching '('
-                while (!operations.empty() && operations.top() != '(')
+                while (!operations.empty() && operations.back() != '(')
                 {
-                    values.push(std::string(1, operations.top()));
-                    operations.pop();
+                    values.push_back({toOpCode(operations.back()), 0, 0.0});
+                    operations.pop_back();
                 }
 
                 // Remove the '(' if it exists
                 if (!operations.empty())
                 {
-                    operations.pop();
-                }
-
-                // Check for implicit multiplication: (2)(3) -> (2)*(3)
-                if (i + 1 < expression.length() && !isOperator(expression[i + 1]))
-                {
-                    operations.push('*');
+                    operations.pop_back();
                 }
+                previous = Previous::CloseParen;
             }
 
             // Handle operators with precedence rules
             else if (isOperator(expression[i]))
             {
                 // Pop operators with higher or equal precedence
-                while (!operations.empty() && getPrecedence(operations.top()) >= getPrecedence(expression[i]))
+                while (!operations.empty() && getPrecedence(operations.back()) >= getPrecedence(expression[i]))
                 {
-                    values.push(std::string(1, operations.top()));
-                    operations.pop();
+                    values.push_back({toOpCode(operations.back()), 0, 0.0});
+                    operations.pop_back();
                 }
-                operations.push(expression[i]);
+                operations.push_back(expression[i]);
+                previous = Previous::Operator;
             }
         }
 
@@ -227,59 +851,303 @@ private:
         {
             // if there is '(' left in the operator stack, just remove it
             // e.g., the expression like (9)9 will result in '(' and '*' in operators but only '*' is to be used
-            if (operations.top()=='(')
+            if (operations.back()=='(')
             {
-                operations.pop();
+                operations.pop_back();
             }
-            // else, push back all other operators into the queue
+            // else, push back all other operators into the output
             else {
-                values.push(std::string(1, operations.top()));
-                operations.pop();
+                values.push_back({toOpCode(operations.back()), 0, 0.0});
+                operations.pop_back();
+            }
+        }
+
+        return {};
+    }
+
+    // Fixed-capacity stack for eval in constant expressions, where std::vector cannot be used
+    template<typename T>
+    struct ConstantStack
+    {
+        T items[CONSTANT_STACK_SIZE] = {};
+        size_t count = 0;
+
+        constexpr void push_back(const T value)
+        {
+            if (count == CONSTANT_STACK_SIZE)
+            {
+                throw std::invalid_argument("Expression too deeply nested for constant evaluation");
+            }
+            items[count++] = value;
+        }
+
+        constexpr void pop_back()
+        {
+            --count;
+        }
+
+        constexpr T& back()
+        {
+            return items[count - 1];
+        }
+
+        constexpr bool empty() const
+        {
+            return count == 0;
+        }
+
+        constexpr size_t size() const
+        {
+            return count;
+        }
+    };
+
+    // Output of the Shunting Yard translation for eval: applies each operator as soon as it is emitted
+    // Errors are recorded and reported after the whole expression was read, in the order of tryCompile:
+    // lexical errors first, then a malformed structure, then a division by zero
+    struct ConstantEvaluation
+    {
+        ConstantStack<double> operands;
+        bool malformed = false;
+        bool divideByZero = false;
+
+        constexpr void push_back(const Token& token)
+        {
+            if (token.op == OpCode::Number)
+            {
+                operands.push_back(token.value);
+                return;
+            }
+            if (malformed || operands.size() < 2)
+            {
+                malformed = true;
+                return;
+            }
+
+            const double b = operands.back();
+            operands.pop_back();
+            if (token.op == OpCode::Divide && b == 0)
+            {
+                divideByZero = true;
+                return;
+            }
+            operands.back() = calculate(operands.back(), b, token.op);
+        }
+
+        constexpr EvaluationError error(const size_t length) const
+        {
+            if (malformed || operands.size() != 1)
+            {
+                return {ErrorKind::InvalidExpression, 0, length};
+            }
+            if (divideByZero)
+            {
+                return {ErrorKind::DivideByZero, 0, length};
             }
+            return {};
         }
+    };
 
-        return values;
+    // Run a compiled expression without variables; a division by zero is reported for the whole expression
+    static Result<double> evaluateCompiled(const CompiledExpression& compiled, const std::string_view expression)
+    {
+        const Result<double> result = compiled.tryEvaluate(nullptr);
+        if (!result)
+        {
+            return EvaluationError{result.error().kind, 0, expression.length()};
+        }
+        return result;
+    }
+
+    // Look up the compiled form of an expression in this thread's cache
+    // Repeated inputs skip lexing and the Shunting Yard translation entirely
+    // Only compiled expressions are cached: a malformed expression is compiled again each time it is seen,
+    // which reports its error at the positions of this spelling of it
+    static Result<const CompiledExpression*> compileCached(const std::string_view expression)
+    {
+        thread_local LruCache<std::string, CompiledExpression> cache(expressionCacheSize);
+        std::string& key = Evaluator::local().key_;
+        normalizeExpression(expression, key);
+        if (const CompiledExpression* cached = cache.find(key))
+        {
+            return cached;
+        }
+
+        Result<CompiledExpression> compiled = tryCompile(expression);
+        if (!compiled)
+        {
+            return compiled.error();
+        }
+        return &cache.insert(key, std::move(compiled).value());
     }
 
     // Evaluate a mathematical expression using postfix notation
     // Supports complex expressions with multiple operators and parentheses
-    static double evaluateExpression(const std::string& expression)
+    static double evaluateExpression(const std::string_view expression)
     {
-        // Convert infix expression to postfix
-        std::queue<std::string> postfixQueue = translateToPostfix(expression);
-        double result;
-        std::stack<double> postfixStack;
+        const Result<double> result = tryEvaluate(expression);
+        if (!result)
+        {
+            throwError(result.error(), expression);
+        }
+        return result.value();
+    }
+
+    // Deepest nesting of parentheses and implicit multiplications evaluated by recursion in evaluateDirect
+    static constexpr int MAX_DIRECT_DEPTH = 256;
+
+    // Evaluate an expression in a single pass by precedence climbing, without building a postfix program
+    // Well-formed input gives the same value as evaluateExpression. Anything the grammar below does not
+    // accept, and any error, is handed to evaluateExpression, so errors and the results of unusual input
+    // (unbalanced parentheses, stray characters) are exactly those of the compiled path.
+    static double evaluateDirect(const std::string_view expression)
+    {
+        try {
+            size_t i = 0;
+            double value = 0.0;
+            if (parseExpression(expression, i, 1, 0, value) && skipSpace(expression, i) == expression.length())
+            {
+                return value;
+            }
+        }
+        catch (const std::exception&) {
+            // Reported by the compiled path below
+        }
+        return evaluateExpression(expression);
+    }
 
-        // Process postfix expression
-        while (!postfixQueue.empty())
+    static size_t skipSpace(const std::string_view expression, size_t& i)
+    {
+        while (i < expression.length() && isSpace(expression[i]))
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    // expression := operand { operator expression of higher precedence }
+    // Every operator is left-associative, as in the Shunting Yard translation
+    static bool parseExpression(const std::string_view expression, size_t& i, const int minPrecedence,
+                                const int depth, double& value)
+    {
+        if (!parseOperand(expression, i, depth, value))
         {
-            std::string token = postfixQueue.front();
-            postfixQueue.pop();
+            return false;
+        }
 
-            // If current token is an operator
-            if (isOperator(token[0]) && token.length() == 1)
+        while (skipSpace(expression, i) < expression.length() && isOperator(expression[i]) &&
+               getPrecedence(expression[i]) >= minPrecedence)
+        {
+            const char op = expression[i++];
+            double right = 0.0;
+            if (!parseExpression(expression, i, getPrecedence(op) + 1, depth, right))
             {
-                // Ensure enough operands are available
-                if (postfixStack.size() < 2)
-                {
-                    throw std::runtime_error("Invalid expression");
-                }
+                return false;
+            }
+            value = calculate(value, right, toOpCode(op));
+        }
+        return true;
+    }
+
+    // operand := primary [ implicit '*' expression of ^ precedence ]
+    // The Shunting Yard translation pushes an implicit '*' without popping, so it takes just the
+    // preceding primary as its left operand and binds tighter than the operator before it:
+    // 2^3(4) is 2^(3*4), 3(4)^2 is 3*(4^2) and 2(3)(4) is 2*(3*4)
+    static bool parseOperand(const std::string_view expression, size_t& i, const int depth, double& value)
+    {
+        bool group = false;
+        if (!parsePrimary(expression, i, depth, value, group))
+        {
+            return false;
+        }
 
-                // Pop two operands and perform calculation
-                const double second = postfixStack.top();
-                postfixStack.pop();
-                const double first = postfixStack.top();
-                postfixStack.pop();
-                result = calculate(first, second, token[0]);
-                postfixStack.push(result);
+        // Implicit multiplication: 2x, 2(3), (2)(3) and (2)3
+        if (skipSpace(expression, i) < expression.length() &&
+            (isAlpha(expression[i]) || expression[i] == '_' || expression[i] == '(' ||
+             (group && (isDigit(expression[i]) || expression[i] == '.'))))
+        {
+            // Each one nests a level, so long chains such as 2 pi pi pi also fall back to the compiled path
+            double right = 0.0;
+            if (depth == MAX_DIRECT_DEPTH || !parseExpression(expression, i, getPrecedence('^'), depth + 1, right))
+            {
+                return false;
             }
-            else
+            value = calculate(value, right, OpCode::Multiply);
+        }
+        return true;
+    }
+
+    // primary := number | -number | name | -name | ( expression )
+    // group tells whether the primary was parenthesized, after which a number also multiplies implicitly
+    static bool parsePrimary(const std::string_view expression, size_t& i, const int depth, double& value,
+                             bool& group)
+    {
+        if (skipSpace(expression, i) == expression.length())
+        {
+            return false;
+        }
+
+        if (expression[i] == '(')
+        {
+            ++i;
+            if (depth == MAX_DIRECT_DEPTH || !parseExpression(expression, i, 1, depth + 1, value) ||
+                skipSpace(expression, i) == expression.length() || expression[i] != ')')
             {
-                // If token is a number, push to stack
-                postfixStack.push(std::stod(token));
+                return false;
             }
+            ++i;
+            group = true;
+            return true;
         }
 
-        return result;
+        bool negative = false;
+        if (expression[i] == '-')
+        {
+            negative = true;
+            ++i;
+            skipSpace(expression, i);
+        }
+
+        if (i < expression.length() && (isAlpha(expression[i]) || expression[i] == '_'))
+        {
+            Token token{};
+            if (readIdentifier(expression, i, nullptr, token))
+            {
+                return false;
+            }
+            value = token.value;
+            if (negative)
+            {
+                value = calculate(value, -1.0, OpCode::Multiply);
+            }
+        }
+        else if (i < expression.length() && (isDigit(expression[i]) || expression[i] == '.' || expression[i] == '-'))
+        {
+            if (parseNumber(expression, i, negative, value))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            return false;
+        }
+        ++i;
+        return true;
     }
-};
\ No newline at end of file
+};
+
+// Compile-time checks of the constant evaluator
+static_assert(ScientificCalculator::eval("2*(3+4)") == 14);
+static_assert(ScientificCalculator::eval("2(3)(4)") == 24);
+static_assert(ScientificCalculator::eval("(2)3 + 2 - 3") == 5);
+static_assert(ScientificCalculator::eval("-2^2") == 4);
+static_assert(ScientificCalculator::eval("10 - -3") == 13);
+static_assert(ScientificCalculator::eval("2^3^2") == 64);
+static_assert(ScientificCalculator::eval("2^-2") == 0.25);
+static_assert(ScientificCalculator::eval("1.5e3 / 3") == 500);
+static_assert(ScientificCalculator::eval("2pi") == 2 * 3.14159265358979323846);
+static_assert(ScientificCalculator::eval("-e") == -2.71828182845904523536);
+static_assert(ScientificCalculator::eval("5.166e-12") == 5.166e-12);
+static_assert(ScientificCalculator::eval("129719.31143419") == 129719.31143419);
+static_assert(ScientificCalculator::eval("491.e-8") == 491.e-8);
@@ -0,0 +1,304 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <cstring>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+
+#include "postfix.hpp"
+#include "calculator.hpp"
+
+// CppEmitter: Ahead-of-time code generation for a fixed set of formulas
+// Reads definitions of the form "name(x, y) = expression", one per line ('#' starts a comment line),
+// and writes a self-contained C++ header with one function per formula. The functions follow
+// calculate exactly: the same optimized operations in the same order, and division by zero
+// throws std::runtime_error("Divide by zero"). Formulas without ^ or square roots are constexpr.
+class CppEmitter {
+public:
+    // A parsed formula definition
+    struct Definition
+    {
+        std::string name;
+        std::vector<std::string> parameters;
+        std::string expression;
+    };
+
+    // Read all definitions and write the header
+    // Throws std::invalid_argument naming the line of a malformed definition or expression, or of a
+    // function defined twice
+    static void emit(std::istream& in, std::ostream& out)
+    {
+        // Translate every formula before writing anything, so a bad line produces no partial header
+        std::string functions;
+        std::vector<std::string> names;
+        std::string line;
+        for (size_t number = 1; getline(in, line); ++number)
+        {
+            const std::string_view text = trim(line);
+            if (text.empty() || text.front() == '#')
+            {
+                continue;
+            }
+
+            try {
+                Definition definition = parseDefinition(text);
+                if (std::find(names.begin(), names.end(), definition.name) != names.end())
+                {
+                    throw std::invalid_argument("Function defined twice: " + definition.name);
+                }
+                functions += emitFunction(definition);
+                names.push_back(std::move(definition.name));
+            }
+            catch (const std::exception& e) {
+                throw std::invalid_argument("Line " + std::to_string(number) + ": " + e.what());
+            }
+        }
+
+        out << "// Generated by Calculator --emit-cpp. Do not edit.\n\n"
+            << "#pragma once\n\n"
+            << "#include <cmath>\n"
+            << "#include <limits>\n"
+            << "#include <stdexcept>\n\n"
+            << "namespace calculator {\n\n"
+            << "namespace detail {\n\n"
+            << "constexpr double divide(const double a, const double b)\n"
+            << "{\n"
+            << "    if (b == 0)\n"
+            << "    {\n"
+            << "        throw std::runtime_error(\"Divide by zero\");\n"
+            << "    }\n"
+            << "    return a / b;\n"
+            << "}\n\n"
+            << "constexpr double square(const double a)\n"
+            << "{\n"
+            << "    return a * a;\n"
+            << "}\n\n"
+            << "constexpr double powerInteger(const double base, const long long exponent)\n"
+            << "{\n"
+            << "    double result = 1.0;\n"
+            << "    double factor = base;\n"
+            << "    for (unsigned long long n = exponent < 0 ? -exponent : exponent; n != 0; n >>= 1)\n"
+            << "    {\n"
+            << "        if (n & 1)\n"
+            << "        {\n"
+            << "            result *= factor;\n"
+            << "        }\n"
+            << "        factor *= factor;\n"
+            << "    }\n"
+            << "    return exponent < 0 ? 1.0 / result : result;\n"
+            << "}\n\n"
+            << "inline double power(const double a, const double b)\n"
+            << "{\n"
+            << "    if (b == std::trunc(b) && std::fabs(b) <= " << MAX_INTEGER_EXPONENT << ")\n"
+            << "    {\n"
+            << "        return powerInteger(a, static_cast<long long>(b));\n"
+            << "    }\n"
+            << "    return std::pow(a, b);\n"
+            << "}\n\n"
+            << "} // namespace detail\n"
+            << functions
+            << "\n} // namespace calculator\n";
+    }
+
+    // Parse "name(x, y) = expression" or "name = expression"
+    static Definition parseDefinition(const std::string_view text)
+    {
+        const size_t equals = text.find('=');
+        if (equals == std::string_view::npos)
+        {
+            throw std::invalid_argument("Expected name(parameters) = expression");
+        }
+
+        Definition definition;
+        definition.expression = std::string(trim(text.substr(equals + 1)));
+
+        std::string_view head = trim(text.substr(0, equals));
+        const size_t open = head.find('(');
+        definition.name = std::string(trim(head.substr(0, open)));
+        checkIdentifier(definition.name);
+
+        if (open != std::string_view::npos)
+        {
+            if (head.back() != ')')
+            {
+                throw std::invalid_argument("Missing ')' after the parameters of " + definition.name);
+            }
+            std::string_view parameters = head.substr(open + 1, head.length() - open - 2);
+            while (!trim(parameters).empty())
+            {
+                const size_t comma = parameters.find(',');
+                const std::string_view parameter = trim(parameters.substr(0, comma));
+                checkIdentifier(parameter);
+                if (std::find(definition.parameters.begin(), definition.parameters.end(), parameter) !=
+                    definition.parameters.end())
+                {
+                    throw std::invalid_argument("Parameter given twice: " + std::string(parameter));
+                }
+                definition.parameters.emplace_back(parameter);
+                parameters = comma == std::string_view::npos ? std::string_view() : parameters.substr(comma + 1);
+            }
+        }
+
+        return definition;
+    }
+
+private:
+    // Translate one formula into a function definition
+    static std::string emitFunction(const Definition& definition)
+    {
+        const CompiledExpression expression = ScientificCalculator::compile(definition.expression, definition.parameters);
+
+        // Build the C++ expression bottom-up with the same operand stack as the evaluator
+        std::vector<std::string> operands;
+        bool constantEvaluable = true;
+        for (const Token& token : expression.program())
+        {
+            switch (token.op)
+            {
+                case OpCode::Number:
+                    operands.push_back(literal(token.value));
+                    break;
+                case OpCode::Variable:
+                    operands.push_back(definition.parameters[token.slot]);
+                    break;
+                case OpCode::Square:
+                    operands.back() = "detail::square(" + operands.back() + ")";
+                    break;
+                case OpCode::SquareRoot:
+                    operands.back() = "std::sqrt(" + operands.back() + ")";
+                    constantEvaluable = false;
+                    break;
+                case OpCode::PowerInteger:
+                    operands.back() = "detail::powerInteger(" + operands.back() + ", " +
+                                      std::to_string(static_cast<long long>(token.value)) + ")";
+                    break;
+                default:
+                {
+                    const std::string right = std::move(operands.back());
+                    operands.pop_back();
+                    std::string& left = operands.back();
+                    switch (token.op)
+                    {
+                        case OpCode::Add: left = "(" + left + " + " + right + ")"; break;
+                        case OpCode::Subtract: left = "(" + left + " - " + right + ")"; break;
+                        case OpCode::Multiply: left = "(" + left + " * " + right + ")"; break;
+                        case OpCode::Divide: left = "detail::divide(" + left + ", " + right + ")"; break;
+                        default:
+                            left = "detail::power(" + left + ", " + right + ")";
+                            constantEvaluable = false;
+                            break;
+                    }
+                    break;
+                }
+            }
+        }
+
+        std::string function = "\n// " + definition.name + " = " + commentText(definition.expression) + "\n" +
+                               (constantEvaluable ? "constexpr" : "inline") + " double " + definition.name + "(";
+        for (size_t i = 0; i < definition.parameters.size(); ++i)
+        {
+            function += (i == 0 ? "" : ", ") + std::string("const double ") + definition.parameters[i];
+        }
+        return function + ")\n{\n    return " + operands.back() + ";\n}\n";
+    }
+
+    // Format a constant so that it reads back as exactly the same double
+    static std::string literal(const double value)
+    {
+        if (std::isnan(value))
+        {
+            return "std::numeric_limits<double>::quiet_NaN()";
+        }
+        if (std::isinf(value))
+        {
+            return value < 0 ? "(-std::numeric_limits<double>::infinity())" : "std::numeric_limits<double>::infinity()";
+        }
+
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        std::string text(digits, result.ptr);
+        if (text.find_first_of(".e") == std::string::npos)
+        {
+            text += ".0";
+        }
+        return value < 0 || std::signbit(value) ? "(" + text + ")" : text;
+    }
+
+    static std::string_view trim(std::string_view text)
+    {
+        while (!text.empty() && isspace(static_cast<unsigned char>(text.front())))
+        {
+            text.remove_prefix(1);
+        }
+        while (!text.empty() && isspace(static_cast<unsigned char>(text.back())))
+        {
+            text.remove_suffix(1);
+        }
+        return text;
+    }
+
+    // The expression as it is shown in the comment above its function
+    // Only the characters the lexer reads are kept and whitespace is collapsed, so that no input, such as a
+    // trailing '\', can continue the comment onto the next generated line
+    static std::string commentText(const std::string_view expression)
+    {
+        std::string text;
+        for (const char c : expression)
+        {
+            if (isspace(static_cast<unsigned char>(c)))
+            {
+                if (!text.empty() && text.back() != ' ')
+                {
+                    text += ' ';
+                }
+            }
+            else if (isalnum(static_cast<unsigned char>(c)) || (c != '\0' && std::strchr("_.+-*/^()", c) != nullptr))
+            {
+                text += c;
+            }
+        }
+        return std::string(trim(text));
+    }
+
+    // Names that cannot be used in the generated header: the keywords and alternative tokens of C++,
+    // the names the header's function bodies refer to and the macros of <cmath>
+    static constexpr std::string_view RESERVED_NAMES[] = {
+        "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case",
+        "catch", "char", "char8_t", "char16_t", "char32_t", "class", "co_await", "co_return", "co_yield",
+        "compl", "concept", "const", "const_cast", "consteval", "constexpr", "constinit", "continue",
+        "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export",
+        "extern", "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable",
+        "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+        "protected", "public", "register", "reinterpret_cast", "requires", "return", "short", "signed",
+        "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template", "this",
+        "thread_local", "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+        "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq",
+        "detail", "std",
+        "INFINITY", "NAN", "HUGE_VAL", "HUGE_VALF", "HUGE_VALL", "FP_INFINITE", "FP_NAN", "FP_NORMAL",
+        "FP_SUBNORMAL", "FP_ZERO", "FP_FAST_FMA", "FP_FAST_FMAF", "FP_FAST_FMAL", "FP_ILOGB0", "FP_ILOGBNAN",
+        "MATH_ERRNO", "MATH_ERREXCEPT", "math_errhandling"
+    };
+
+    // A name must be a variable name of the calculator and a C++ identifier that is free to use:
+    // not reserved above, and not reserved to the implementation by a double underscore or an
+    // underscore followed by an upper-case letter
+    static void checkIdentifier(const std::string_view name)
+    {
+        const bool reserved = name.find("__") != std::string_view::npos ||
+                              (name.length() >= 2 && name[0] == '_' && isupper(static_cast<unsigned char>(name[1]))) ||
+                              std::find(std::begin(RESERVED_NAMES), std::end(RESERVED_NAMES), name) !=
+                                  std::end(RESERVED_NAMES);
+        if (!ScientificCalculator::isVariableName(name) || reserved)
+        {
+            throw std::invalid_argument("Invalid name: " + std::string(name));
+        }
+    }
+};
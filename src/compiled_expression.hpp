@@ -0,0 +1,135 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+
+#include "result.hpp"
+#include "postfix.hpp"
+#include "optimizer.hpp"
+#include "register_vm.hpp"
+#include "threaded_code.hpp"
+#include "vector_kernels.hpp"
+
+// CompiledExpression: An expression that has already been lexed, translated to postfix, simplified
+// into a DAG with shared subexpressions and lowered to threaded register code
+// Produced by ScientificCalculator::compile and evaluated any number of times without re-parsing
+class CompiledExpression {
+public:
+    // Evaluate the compiled program with one value per variable, in the order given to compile
+    double evaluate(const std::vector<double>& values = {}) const
+    {
+        checkVariableCount(values.size());
+        return evaluate(values.data());
+    }
+
+    // Evaluate the compiled program with values pointing to one value per variable
+    // Runs the threaded register code on a local register file, or a reused per-thread buffer
+    // for very large programs, so evaluation itself never allocates
+    double evaluate(const double* values) const
+    {
+        return threaded_.evaluate(values);
+    }
+
+    // Non-throwing evaluation: the value, or ErrorKind::DivideByZero
+    Result<double> tryEvaluate(const double* values) const
+    {
+        double result = 0.0;
+        if (!threaded_.evaluate(values, result))
+        {
+            return EvaluationError{ErrorKind::DivideByZero};
+        }
+        return result;
+    }
+
+    // Evaluate the compiled program over whole input arrays, one result per row
+    // columns[k] holds count values of the k-th variable
+    void evaluateColumns(const double* const* columns, const std::size_t count, double* results) const
+    {
+        evaluatePostfixColumns(program_, columns, count, results);
+    }
+
+    // Non-throwing evaluateColumns: ErrorKind::DivideByZero when any row divides by zero, in which
+    // case the results are unspecified
+    Result<void> tryEvaluateColumns(const double* const* columns, const std::size_t count, double* results) const
+    {
+        if (!tryEvaluatePostfixColumns(program_, columns, count, results))
+        {
+            return EvaluationError{ErrorKind::DivideByZero};
+        }
+        return {};
+    }
+
+    // Evaluate the compiled program over whole input arrays of equal length
+    std::vector<double> evaluateColumns(const std::vector<std::vector<double>>& columns) const
+    {
+        checkVariableCount(columns.size());
+
+        const std::size_t count = columns.empty() ? 1 : columns.front().size();
+        std::vector<const double*> pointers;
+        for (const std::vector<double>& column : columns)
+        {
+            if (column.size() != count)
+            {
+                throw std::invalid_argument("Input columns differ in length");
+            }
+            pointers.push_back(column.data());
+        }
+
+        std::vector<double> results(count);
+        evaluateColumns(pointers.data(), count, results.data());
+        return results;
+    }
+
+    // Number of variables the expression was compiled with
+    std::size_t variableCount() const
+    {
+        return variableCount_;
+    }
+
+    // Access the underlying postfix program
+    const std::vector<Token>& program() const
+    {
+        return program_;
+    }
+
+    // Number of nodes of the simplified expression before common subexpressions were shared
+    std::size_t treeNodeCount() const
+    {
+        return treeNodeCount_;
+    }
+
+    // Number of distinct nodes after sharing, the operations and operands one evaluation computes
+    std::size_t dagNodeCount() const
+    {
+        return dagNodeCount_;
+    }
+
+private:
+    friend class ScientificCalculator;
+
+    CompiledExpression(const ExpressionTree& tree, const std::size_t variableCount)
+        : program_(tree.toPostfix()), variableCount_(variableCount),
+          treeNodeCount_(tree.treeSize()), dagNodeCount_(tree.dagSize()),
+          threaded_(ThreadedProgram::fromRegisters(RegisterProgram::fromTree(tree, variableCount)))
+    {
+    }
+
+    // Make sure the caller provided exactly one value per variable
+    void checkVariableCount(const std::size_t count) const
+    {
+        if (count != variableCount_)
+        {
+            throw std::invalid_argument("Expected " + std::to_string(variableCount_) + " variable values");
+        }
+    }
+
+    std::vector<Token> program_;
+    std::size_t variableCount_;
+    std::size_t treeNodeCount_;
+    std::size_t dagNodeCount_;
+    ThreadedProgram threaded_;
+};
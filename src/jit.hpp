@@ -0,0 +1,365 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "result.hpp"
+#include "postfix.hpp"
+#include "compiled_expression.hpp"
+
+// The native backend emits x86-64 SSE2 code and needs mmap, so it is only built on x86-64 Linux
+// Everywhere else JitExpression simply runs the interpreter
+#if defined(__x86_64__) && defined(__linux__)
+#define CALCULATOR_JIT_AVAILABLE 1
+#include <sys/mman.h>
+#else
+#define CALCULATOR_JIT_AVAILABLE 0
+#endif
+
+// Signature of a JIT-compiled expression: variables holds one value per variable slot
+// Returns NaN when a division by zero occurs
+using NativeFunction = double (*)(const double* variables);
+
+// JitExpression: A compiled expression translated to native machine code
+// The operand stack of the postfix program maps onto the xmm registers, so programs that need
+// more than 14 stack entries, or the general ^ operator (a call to pow), stay on the interpreter.
+// evaluate() behaves exactly like CompiledExpression::evaluate, including the divide by zero error
+class JitExpression {
+public:
+    explicit JitExpression(CompiledExpression expression)
+        : expression_(std::move(expression))
+    {
+#if CALCULATOR_JIT_AVAILABLE
+        compileNative();
+#endif
+    }
+
+    ~JitExpression()
+    {
+#if CALCULATOR_JIT_AVAILABLE
+        if (code_ != nullptr)
+        {
+            munmap(code_, codeSize_);
+        }
+#endif
+    }
+
+    JitExpression(const JitExpression&) = delete;
+    JitExpression& operator=(const JitExpression&) = delete;
+
+    JitExpression(JitExpression&& other) noexcept
+        : expression_(std::move(other.expression_)),
+          code_(std::exchange(other.code_, nullptr)),
+          codeSize_(std::exchange(other.codeSize_, 0))
+    {
+    }
+
+    // Evaluate with values pointing to one value per variable
+    // A NaN from native code is re-evaluated by the interpreter, which raises the divide by zero
+    // error or reproduces a genuine NaN result
+    double evaluate(const double* values) const
+    {
+        if (code_ != nullptr)
+        {
+            const double result = function()(values);
+            if (!std::isnan(result))
+            {
+                return result;
+            }
+        }
+        return expression_.evaluate(values);
+    }
+
+    double evaluate(const std::vector<double>& values = {}) const
+    {
+        if (values.size() != expression_.variableCount())
+        {
+            return expression_.evaluate(values);
+        }
+        return evaluate(values.data());
+    }
+
+    // Non-throwing evaluation: the value, or ErrorKind::DivideByZero like CompiledExpression::tryEvaluate
+    Result<double> tryEvaluate(const double* values) const
+    {
+        if (code_ != nullptr)
+        {
+            const double result = function()(values);
+            if (!std::isnan(result))
+            {
+                return result;
+            }
+        }
+        return expression_.tryEvaluate(values);
+    }
+
+    // Whether native code was generated for this expression
+    bool isNative() const
+    {
+        return code_ != nullptr;
+    }
+
+    // The native function, or nullptr when the expression runs on the interpreter
+    NativeFunction function() const
+    {
+        return reinterpret_cast<NativeFunction>(code_);
+    }
+
+    const CompiledExpression& expression() const
+    {
+        return expression_;
+    }
+
+private:
+#if CALCULATOR_JIT_AVAILABLE
+    // xmm0 to xmm13 hold the operand stack, xmm14 and xmm15 are scratch registers
+    static constexpr int STACK_REGISTERS = 14;
+    static constexpr int SCRATCH_RESULT = 14;
+    static constexpr int SCRATCH_FACTOR = 15;
+
+    // Machine code buffer with the fixups that are resolved once the layout is known
+    struct Assembler
+    {
+        std::vector<uint8_t> code;
+        std::vector<double> constants;
+        std::vector<std::pair<size_t, size_t>> constantFixups;   // (rel32 position, constant index)
+        std::vector<size_t> trapFixups;                         // rel32 positions of jumps to the trap
+
+        void byte(const uint8_t value)
+        {
+            code.push_back(value);
+        }
+
+        void rel32()
+        {
+            code.insert(code.end(), 4, 0);
+        }
+
+        // Optional REX prefix for xmm8 to xmm15 in the reg and rm fields
+        void rex(const int reg, const int rm)
+        {
+            const uint8_t prefix = 0x40 | ((reg & 8) ? 0x04 : 0) | ((rm & 8) ? 0x01 : 0);
+            if (prefix != 0x40)
+            {
+                byte(prefix);
+            }
+        }
+
+        // Register to register SSE instruction: prefix 0F opcode, ModRM with mod = 11
+        void registerOp(const uint8_t prefix, const uint8_t opcode, const int dst, const int src)
+        {
+            byte(prefix);
+            rex(dst, src);
+            byte(0x0F);
+            byte(opcode);
+            byte(static_cast<uint8_t>(0xC0 | ((dst & 7) << 3) | (src & 7)));
+        }
+
+        // Instruction with a RIP-relative constant operand
+        void constantOp(const uint8_t prefix, const uint8_t opcode, const int reg, const double value)
+        {
+            byte(prefix);
+            rex(reg, 0);
+            byte(0x0F);
+            byte(opcode);
+            byte(static_cast<uint8_t>(0x05 | ((reg & 7) << 3)));
+            constantFixups.emplace_back(code.size(), constantIndex(value));
+            rel32();
+        }
+
+        size_t constantIndex(const double value)
+        {
+            for (size_t i = 0; i < constants.size(); ++i)
+            {
+                if (memcmp(&constants[i], &value, sizeof(double)) == 0)
+                {
+                    return i;
+                }
+            }
+            constants.push_back(value);
+            return constants.size() - 1;
+        }
+
+        void loadConstant(const int reg, const double value) { constantOp(0xF2, 0x10, reg, value); }
+        void move(const int dst, const int src) { registerOp(0x66, 0x28, dst, src); }
+        void add(const int dst, const int src) { registerOp(0xF2, 0x58, dst, src); }
+        void multiply(const int dst, const int src) { registerOp(0xF2, 0x59, dst, src); }
+        void subtract(const int dst, const int src) { registerOp(0xF2, 0x5C, dst, src); }
+        void divide(const int dst, const int src) { registerOp(0xF2, 0x5E, dst, src); }
+        void squareRoot(const int dst, const int src) { registerOp(0xF2, 0x51, dst, src); }
+
+        // movsd xmm, [rdi + 8 * slot]
+        void loadVariable(const int reg, const unsigned slot)
+        {
+            byte(0xF2);
+            rex(reg, 0);
+            byte(0x0F);
+            byte(0x10);
+            byte(static_cast<uint8_t>(0x87 | ((reg & 7) << 3)));
+            const uint32_t displacement = slot * 8;
+            for (int shift = 0; shift < 32; shift += 8)
+            {
+                byte(static_cast<uint8_t>(displacement >> shift));
+            }
+        }
+
+        // Jump to the trap, which returns NaN, when reg compares equal to zero (or is NaN)
+        void trapIfZero(const int reg)
+        {
+            constantOp(0x66, 0x2E, reg, 0.0);   // ucomisd reg, [zero]
+            byte(0x0F);
+            byte(0x84);                         // je trap
+            trapFixups.push_back(code.size());
+            rel32();
+        }
+    };
+
+    static void patch(std::vector<uint8_t>& code, const size_t position, const size_t target)
+    {
+        const int32_t offset = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(position + 4));
+        memcpy(&code[position], &offset, sizeof(offset));
+    }
+
+    // Translate the postfix program; leaves code_ empty when it cannot be compiled
+    void compileNative()
+    {
+        Assembler assembler;
+        int depth = 0;
+
+        for (const Token& token : expression_.program())
+        {
+            switch (token.op)
+            {
+                case OpCode::Number:
+                case OpCode::Variable:
+                    if (depth == STACK_REGISTERS)
+                    {
+                        return;
+                    }
+                    if (token.op == OpCode::Number)
+                    {
+                        assembler.loadConstant(depth, token.value);
+                    }
+                    else
+                    {
+                        assembler.loadVariable(depth, token.slot);
+                    }
+                    ++depth;
+                    break;
+                case OpCode::Add:
+                    assembler.add(depth - 2, depth - 1);
+                    --depth;
+                    break;
+                case OpCode::Subtract:
+                    assembler.subtract(depth - 2, depth - 1);
+                    --depth;
+                    break;
+                case OpCode::Multiply:
+                    assembler.multiply(depth - 2, depth - 1);
+                    --depth;
+                    break;
+                case OpCode::Divide:
+                    assembler.trapIfZero(depth - 1);
+                    assembler.divide(depth - 2, depth - 1);
+                    --depth;
+                    break;
+                case OpCode::Square:
+                    assembler.multiply(depth - 1, depth - 1);
+                    break;
+                case OpCode::SquareRoot:
+                    assembler.squareRoot(depth - 1, depth - 1);
+                    break;
+                case OpCode::PowerInteger:
+                    emitPowerInteger(assembler, depth - 1, static_cast<long long>(token.value));
+                    break;
+                default:
+                    // The general power operator needs a call to pow and stays on the interpreter
+                    return;
+            }
+        }
+
+        // Return the result in xmm0
+        assembler.byte(0xC3);   // ret
+
+        // Trap: return NaN
+        const size_t trap = assembler.code.size();
+        assembler.loadConstant(0, std::numeric_limits<double>::quiet_NaN());
+        assembler.byte(0xC3);
+
+        // Constant pool after the code, 8-byte aligned
+        while (assembler.code.size() % 8 != 0)
+        {
+            assembler.byte(0xCC);
+        }
+        const size_t pool = assembler.code.size();
+        for (const double constant : assembler.constants)
+        {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&constant);
+            assembler.code.insert(assembler.code.end(), bytes, bytes + sizeof(double));
+        }
+
+        for (const auto& [position, index] : assembler.constantFixups)
+        {
+            patch(assembler.code, position, pool + index * sizeof(double));
+        }
+        for (const size_t position : assembler.trapFixups)
+        {
+            patch(assembler.code, position, trap);
+        }
+
+        // Copy into a fresh mapping, then make it executable and read-only
+        void* memory = mmap(nullptr, assembler.code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            return;
+        }
+        memcpy(memory, assembler.code.data(), assembler.code.size());
+        if (mprotect(memory, assembler.code.size(), PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(memory, assembler.code.size());
+            return;
+        }
+
+        code_ = memory;
+        codeSize_ = assembler.code.size();
+    }
+
+    // Exponentiation by squaring in the same multiplication order as powInteger
+    static void emitPowerInteger(Assembler& assembler, const int reg, const long long exponent)
+    {
+        assembler.loadConstant(SCRATCH_RESULT, 1.0);
+        assembler.move(SCRATCH_FACTOR, reg);
+        for (unsigned long long bits = exponent < 0 ? -exponent : exponent; bits != 0; bits >>= 1)
+        {
+            if (bits & 1)
+            {
+                assembler.multiply(SCRATCH_RESULT, SCRATCH_FACTOR);
+            }
+            if (bits > 1)
+            {
+                assembler.multiply(SCRATCH_FACTOR, SCRATCH_FACTOR);
+            }
+        }
+
+        if (exponent < 0)
+        {
+            assembler.loadConstant(reg, 1.0);
+            assembler.divide(reg, SCRATCH_RESULT);
+        }
+        else
+        {
+            assembler.move(reg, SCRATCH_RESULT);
+        }
+    }
+#endif
+
+    CompiledExpression expression_;
+    void* code_ = nullptr;
+    size_t codeSize_ = 0;
+};
@@ -0,0 +1,125 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+#include "result.hpp"
+
+// LruCache: A bounded cache that evicts the least recently used entry when full
+// Not thread-safe: meant to be owned by a single thread, but the hit and miss counters
+// of every live cache can be read from any thread through totalStatistics()
+template <typename Key, typename Value>
+class LruCache {
+public:
+    explicit LruCache(const size_t capacity)
+        : capacity_(std::max<size_t>(capacity, 1))
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        registry().push_back(this);
+    }
+
+    ~LruCache()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        retired().hits += hits_.load(std::memory_order_relaxed);
+        retired().misses += misses_.load(std::memory_order_relaxed);
+        registry().erase(std::find(registry().begin(), registry().end(), this));
+    }
+
+    LruCache(const LruCache&) = delete;
+    LruCache& operator=(const LruCache&) = delete;
+
+    // Return the cached value for key and make it the most recently used, or nullptr on a miss
+    const Value* find(const Key& key)
+    {
+        const auto found = index_.find(key);
+        if (found == index_.end())
+        {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        entries_.splice(entries_.begin(), entries_, found->second);
+        return &found->second->second;
+    }
+
+    // Store the value of a key that find did not return, evicting the least recently used entry when full
+    // The reference stays valid until the entry is evicted by a later insertion
+    const Value& insert(const Key& key, Value value)
+    {
+        if (entries_.size() >= capacity_)
+        {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.emplace_front(key, std::move(value));
+        index_.emplace(key, entries_.begin());
+        return entries_.front().second;
+    }
+
+    // Counters of this cache
+    CacheStatistics statistics() const
+    {
+        return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed)};
+    }
+
+    // Counters summed over every cache of this type, including destroyed ones
+    static CacheStatistics totalStatistics()
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        CacheStatistics total = retired();
+        for (const LruCache* cache : registry())
+        {
+            const CacheStatistics statistics = cache->statistics();
+            total.hits += statistics.hits;
+            total.misses += statistics.misses;
+        }
+        return total;
+    }
+
+    size_t size() const
+    {
+        return entries_.size();
+    }
+
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    static std::mutex& registryMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<LruCache*>& registry()
+    {
+        static std::vector<LruCache*> caches;
+        return caches;
+    }
+
+    static CacheStatistics& retired()
+    {
+        static CacheStatistics statistics{0, 0};
+        return statistics;
+    }
+
+    using Entry = std::pair<Key, Value>;
+
+    const size_t capacity_;
+    std::list<Entry> entries_;
+    std::unordered_map<Key, typename std::list<Entry>::iterator> index_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+};
@@ -0,0 +1,472 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <memory_resource>
+
+#include "postfix.hpp"
+
+// A node of an expression tree
+// Leaves are numbers and variables, operators refer to their operands by index
+struct ExpressionNode
+{
+    OpCode op;
+    unsigned slot;
+    double value;
+    size_t left;
+    size_t right;
+};
+
+// ExpressionTree: The tree form of a postfix program, simplified while it is built
+// Nodes are stored in one vector in creation order, so every operand precedes its operator
+// Nodes are hash-consed: a structurally identical subexpression is created once and shared,
+// so (a+b)^2*(a+b) holds a single a+b node and the tree is really a DAG
+// The nodes, the index that finds shared nodes and the scratch space of the passes over the tree
+// are allocated from one memory resource, such as the per-thread Arena of the compiler
+class ExpressionTree {
+public:
+    // Build the simplified tree of a postfix program, allocating from memory
+    // Throws std::runtime_error("Invalid expression") when the program is malformed
+    static ExpressionTree fromPostfix(const std::vector<Token>& postfix,
+                                      std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+    {
+        ExpressionTree tree(memory);
+        tree.nodes_.reserve(postfix.size());
+        tree.divides_.reserve(postfix.size());
+        tree.unique_.reserve(postfix.size());
+
+        std::pmr::vector<size_t> operands(memory);
+        for (const Token& token : postfix)
+        {
+            const int count = operandCount(token.op);
+            if (operands.size() < static_cast<size_t>(count))
+            {
+                throw std::runtime_error("Invalid expression");
+            }
+
+            if (count == 0)
+            {
+                operands.push_back(tree.add({token.op, token.slot, token.value, 0, 0}));
+            }
+            else if (count == 1)
+            {
+                operands.back() = tree.makeUnary(token.op, operands.back(), token.value);
+            }
+            else
+            {
+                const size_t right = operands.back();
+                operands.pop_back();
+                operands.back() = tree.makeBinary(token.op, operands.back(), right);
+            }
+        }
+
+        if (operands.size() != 1)
+        {
+            throw std::runtime_error("Invalid expression");
+        }
+        tree.root_ = operands.back();
+        return tree;
+    }
+
+    // Emit the tree as a postfix program
+    // Iterative post-order walk, so very long expressions cannot overflow the call stack
+    std::vector<Token> toPostfix() const
+    {
+        std::vector<Token> postfix;
+        std::pmr::vector<std::pair<size_t, bool>> pending(memory());
+        pending.push_back({root_, false});
+
+        while (!pending.empty())
+        {
+            const auto [index, expanded] = pending.back();
+            pending.pop_back();
+            const ExpressionNode& node = nodes_[index];
+            const int count = operandCount(node.op);
+
+            if (count == 0 || expanded)
+            {
+                postfix.push_back({node.op, node.slot, node.value});
+                continue;
+            }
+
+            pending.push_back({index, true});
+            if (count == 2)
+            {
+                pending.push_back({node.right, false});
+            }
+            pending.push_back({node.left, false});
+        }
+
+        return postfix;
+    }
+
+    // All nodes created while building, including folded ones that the root no longer reaches
+    const std::pmr::vector<ExpressionNode>& nodes() const
+    {
+        return nodes_;
+    }
+
+    // The memory resource the tree allocates from
+    std::pmr::memory_resource* memory() const
+    {
+        return nodes_.get_allocator().resource();
+    }
+
+    size_t root() const
+    {
+        return root_;
+    }
+
+    // Number of nodes the expression would have without sharing, the length of toPostfix()
+    size_t treeSize() const
+    {
+        std::pmr::vector<size_t> sizes(nodes_.size(), 1, memory());
+        for (size_t i = 0; i <= root_; ++i)
+        {
+            const int count = operandCount(nodes_[i].op);
+            if (count >= 1)
+            {
+                sizes[i] += sizes[nodes_[i].left];
+            }
+            if (count == 2)
+            {
+                sizes[i] += sizes[nodes_[i].right];
+            }
+        }
+        return sizes[root_];
+    }
+
+    // Number of distinct nodes reachable from the root
+    size_t dagSize() const
+    {
+        const std::pmr::vector<bool> used = reachable();
+        return static_cast<size_t>(std::count(used.begin(), used.end(), true));
+    }
+
+    // Which nodes the root reaches; operands precede their operators, so one backward pass suffices
+    std::pmr::vector<bool> reachable() const
+    {
+        std::pmr::vector<bool> used(nodes_.size(), false, memory());
+        used[root_] = true;
+        for (size_t i = root_ + 1; i-- > 0;)
+        {
+            if (!used[i])
+            {
+                continue;
+            }
+            const int count = operandCount(nodes_[i].op);
+            if (count >= 1)
+            {
+                used[nodes_[i].left] = true;
+            }
+            if (count == 2)
+            {
+                used[nodes_[i].right] = true;
+            }
+        }
+        return used;
+    }
+
+private:
+    explicit ExpressionTree(std::pmr::memory_resource* memory)
+        : nodes_(memory), divides_(memory), unique_(0, NodeHash(), NodeEqual(), memory)
+    {
+    }
+
+    // Structural identity of a node: numbers compare by bit pattern, so -0 and NaN keep their own nodes
+    struct NodeHash
+    {
+        size_t operator()(const ExpressionNode& node) const
+        {
+            size_t hash = static_cast<size_t>(node.op);
+            for (const size_t part : {static_cast<size_t>(node.slot), static_cast<size_t>(bitPattern(node.value)),
+                                      node.left, node.right})
+            {
+                hash ^= part + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+            }
+            return hash;
+        }
+    };
+
+    struct NodeEqual
+    {
+        bool operator()(const ExpressionNode& a, const ExpressionNode& b) const
+        {
+            return a.op == b.op && a.slot == b.slot && bitPattern(a.value) == bitPattern(b.value) &&
+                   a.left == b.left && a.right == b.right;
+        }
+    };
+
+    static uint64_t bitPattern(const double value)
+    {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // Return the existing node equal to node, or append it
+    size_t add(const ExpressionNode& node)
+    {
+        const auto inserted = unique_.emplace(node, nodes_.size());
+        if (inserted.second)
+        {
+            const int count = operandCount(node.op);
+            divides_.push_back(node.op == OpCode::Divide || (count >= 1 && divides_[node.left]) ||
+                               (count == 2 && divides_[node.right]));
+            nodes_.push_back(node);
+        }
+        return inserted.first->second;
+    }
+
+    bool isNumber(const size_t index, const double value) const
+    {
+        return nodes_[index].op == OpCode::Number && nodes_[index].value == value;
+    }
+
+    // Create a unary node, folding it when the operand is constant
+    // argument is stored in the node value, the exponent for PowerInteger
+    size_t makeUnary(const OpCode op, const size_t operand, const double argument = 0.0)
+    {
+        if (nodes_[operand].op == OpCode::Number)
+        {
+            return add({OpCode::Number, 0, calculateUnary(nodes_[operand].value, op, argument), 0, 0});
+        }
+        return add({op, 0, argument, operand, 0});
+    }
+
+    // Create a binary node after constant folding, identity removal and strength reduction
+    size_t makeBinary(const OpCode op, const size_t left, const size_t right)
+    {
+        const bool leftConstant = nodes_[left].op == OpCode::Number;
+        const bool rightConstant = nodes_[right].op == OpCode::Number;
+
+        // Fold constant subtrees; a constant division by zero is left to fail at evaluation time
+        if (leftConstant && rightConstant && !(op == OpCode::Divide && nodes_[right].value == 0))
+        {
+            return add({OpCode::Number, 0, calculate(nodes_[left].value, nodes_[right].value, op), 0, 0});
+        }
+
+        switch (op)
+        {
+            case OpCode::Add:
+                // x+0 -> x, 0+x -> x
+                if (isNumber(right, 0)) return left;
+                if (isNumber(left, 0)) return right;
+                break;
+            case OpCode::Subtract:
+                // x-0 -> x
+                if (isNumber(right, 0)) return left;
+                break;
+            case OpCode::Multiply:
+                // x*1 -> x, 1*x -> x
+                if (isNumber(right, 1)) return left;
+                if (isNumber(left, 1)) return right;
+                break;
+            case OpCode::Divide:
+                // x/1 -> x
+                if (isNumber(right, 1)) return left;
+                break;
+            case OpCode::Power:
+                // x^1 -> x, x^0 -> 1, x^2 -> x*x, x^0.5 -> sqrt(x), x^n -> repeated squaring
+                // x^0 keeps x when it divides, so that a division by zero in (1/0)^0 is still reported
+                if (isNumber(right, 1)) return left;
+                if (isNumber(right, 0) && !divides_[left]) return add({OpCode::Number, 0, 1.0, 0, 0});
+                if (isNumber(right, 2)) return makeUnary(OpCode::Square, left);
+                if (isNumber(right, 0.5)) return makeUnary(OpCode::SquareRoot, left);
+                if (rightConstant && isSmallIntegerExponent(nodes_[right].value))
+                {
+                    return makeUnary(OpCode::PowerInteger, left, nodes_[right].value);
+                }
+                break;
+            default:
+                break;
+        }
+
+        return add({op, 0, 0.0, left, right});
+    }
+
+    std::pmr::vector<ExpressionNode> nodes_;
+    std::pmr::vector<bool> divides_; // Whether the subtree of each node contains a division
+    std::pmr::unordered_map<ExpressionNode, size_t, NodeHash, NodeEqual> unique_;
+    size_t root_ = 0;
+};
+
+// Largest degree recognized as a polynomial by rewritePolynomial
+constexpr size_t MAX_POLYNOMIAL_DEGREE = 32;
+
+// Rewrite a polynomial in one variable into Horner form: c3*x^3 + c2*x^2 + c1*x + c0 becomes
+// ((c3*x + c2)*x + c1)*x + c0, a chain of multiply-adds that the threaded code fuses
+// Recognizes numbers, a single variable, +, -, *, division by a constant and non-negative integer powers
+// The expression is only replaced when Horner form needs fewer operations, so (x+1)^5 keeps its
+// repeated squaring
+inline ExpressionTree rewritePolynomial(ExpressionTree tree)
+{
+    const std::pmr::vector<ExpressionNode>& nodes = tree.nodes();
+    const std::pmr::vector<bool> used = tree.reachable();
+    std::pmr::memory_resource* memory = tree.memory();
+
+    // Coefficients of every reachable node, lowest degree first; empty when the node is not a polynomial
+    using Polynomial = std::pmr::vector<double>;
+    std::pmr::vector<Polynomial> coefficients(nodes.size(), memory);
+    const auto multiply = [memory](const Polynomial& a, const Polynomial& b) {
+        Polynomial product(memory);
+        if (!a.empty() && !b.empty() && a.size() + b.size() - 2 <= MAX_POLYNOMIAL_DEGREE)
+        {
+            product.assign(a.size() + b.size() - 1, 0.0);
+            for (size_t i = 0; i < a.size(); ++i)
+            {
+                for (size_t j = 0; j < b.size(); ++j)
+                {
+                    product[i + j] += a[i] * b[j];
+                }
+            }
+        }
+        return product;
+    };
+
+    bool hasVariable = false;
+    unsigned slot = 0;
+    size_t cost = 0;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const ExpressionNode& node = nodes[i];
+        if (!used[i])
+        {
+            continue;
+        }
+
+        switch (node.op)
+        {
+            case OpCode::Number:
+                coefficients[i] = {node.value};
+                break;
+            case OpCode::Variable:
+                if (hasVariable && node.slot != slot)
+                {
+                    return tree;
+                }
+                hasVariable = true;
+                slot = node.slot;
+                coefficients[i] = {0.0, 1.0};
+                break;
+            case OpCode::Add:
+            case OpCode::Subtract:
+            {
+                const Polynomial& left = coefficients[node.left];
+                const Polynomial& right = coefficients[node.right];
+                if (!left.empty() && !right.empty())
+                {
+                    Polynomial sum(std::max(left.size(), right.size()), 0.0, memory);
+                    for (size_t k = 0; k < sum.size(); ++k)
+                    {
+                        const double a = k < left.size() ? left[k] : 0.0;
+                        const double b = k < right.size() ? right[k] : 0.0;
+                        sum[k] = node.op == OpCode::Add ? a + b : a - b;
+                    }
+                    coefficients[i] = std::move(sum);
+                }
+                cost += 1;
+                break;
+            }
+            case OpCode::Multiply:
+                coefficients[i] = multiply(coefficients[node.left], coefficients[node.right]);
+                cost += 1;
+                break;
+            case OpCode::Divide:
+                // Only division by a non-zero constant, which divides every coefficient
+                if (nodes[node.right].op == OpCode::Number && nodes[node.right].value != 0)
+                {
+                    coefficients[i] = coefficients[node.left];
+                    for (double& coefficient : coefficients[i])
+                    {
+                        coefficient /= nodes[node.right].value;
+                    }
+                }
+                cost += 1;
+                break;
+            case OpCode::Square:
+                coefficients[i] = multiply(coefficients[node.left], coefficients[node.left]);
+                cost += 1;
+                break;
+            case OpCode::PowerInteger:
+            {
+                // Repeated squaring costs one multiplication per bit plus one per set bit after the first
+                const long long exponent = static_cast<long long>(node.value);
+                if (exponent > 0 && !coefficients[node.left].empty())
+                {
+                    Polynomial power(coefficients[node.left], memory);
+                    for (long long k = 1; k < exponent && !power.empty(); ++k)
+                    {
+                        power = multiply(power, coefficients[node.left]);
+                    }
+                    coefficients[i] = std::move(power);
+                }
+                for (long long bits = exponent; bits > 1; bits >>= 1)
+                {
+                    cost += (bits & 1) ? 2 : 1;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        if (coefficients[i].empty())
+        {
+            return tree;
+        }
+    }
+
+    // Drop leading zero coefficients
+    Polynomial polynomial(coefficients[tree.root()], memory);
+    while (polynomial.size() > 1 && polynomial.back() == 0)
+    {
+        polynomial.pop_back();
+    }
+    const size_t degree = polynomial.size() - 1;
+    if (!hasVariable || degree == 0)
+    {
+        return tree;
+    }
+    for (const double coefficient : polynomial)
+    {
+        if (!std::isfinite(coefficient))
+        {
+            return tree;
+        }
+    }
+
+    // Horner form: one multiplication per degree (none for a leading 1) and one addition per
+    // non-zero lower coefficient
+    size_t hornerCost = degree - (polynomial[degree] == 1 ? 1 : 0);
+    for (size_t k = 0; k < degree; ++k)
+    {
+        hornerCost += polynomial[k] != 0 ? 1 : 0;
+    }
+    if (hornerCost >= cost)
+    {
+        return tree;
+    }
+
+    std::vector<Token> horner{{OpCode::Number, 0, polynomial[degree]}};
+    for (size_t k = degree; k-- > 0;)
+    {
+        horner.push_back({OpCode::Variable, slot, 0.0});
+        horner.push_back({OpCode::Multiply, 0, 0.0});
+        if (polynomial[k] != 0)
+        {
+            horner.push_back({OpCode::Number, 0, polynomial[k]});
+            horner.push_back({OpCode::Add, 0, 0.0});
+        }
+    }
+    return ExpressionTree::fromPostfix(horner, memory);
+}
@@ -0,0 +1,262 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <string_view>
+#include <vector>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <condition_variable>
+
+// Parallel batch pipeline: a reader thread cuts the input into chunks of whole lines,
+// a pool of work-stealing workers evaluates the chunks, and the calling thread writes
+// the results back in input order
+class ParallelBatch {
+public:
+    // Size of the input chunks handed to the workers
+    static constexpr size_t CHUNK_SIZE = 1 << 18;
+
+    // Run the pipeline with the given number of workers
+    // evaluateLine(std::string_view line, std::string& output) must append exactly one output line per input line
+    template <typename LineEvaluator>
+    static void run(std::istream& in, std::ostream& out, const unsigned workers, LineEvaluator evaluateLine)
+    {
+        ParallelBatch batch(workers);
+
+        // Reading a tied stream flushes its tie, which would race with the writer when the tie is out
+        std::ostream* const tie = in.tie(nullptr);
+
+        std::thread reader([&] { batch.read(in); });
+
+        std::vector<std::thread> pool;
+        for (unsigned id = 0; id < workers; ++id)
+        {
+            pool.emplace_back([&, id] { batch.work(id, evaluateLine); });
+        }
+
+        batch.write(out);
+
+        reader.join();
+        for (std::thread& worker : pool)
+        {
+            worker.join();
+        }
+
+        in.tie(tie);
+    }
+
+private:
+    // A block of complete input lines and the output produced for them
+    struct Chunk
+    {
+        size_t index;
+        std::string input;
+        std::string output;
+    };
+
+    // Per-worker deque: the owner takes from the front, thieves take from the back
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<std::unique_ptr<Chunk>> chunks;
+    };
+
+    explicit ParallelBatch(const unsigned workers)
+        : queues_(workers), maxInFlight_(workers * 4)
+    {
+    }
+
+    // Reader thread: cut the input into chunks at line boundaries and deal them out round-robin
+    void read(std::istream& in)
+    {
+        std::string carry;
+        size_t index = 0;
+
+        while (in)
+        {
+            auto chunk = std::make_unique<Chunk>();
+            chunk->index = index;
+            chunk->input.swap(carry);
+
+            const size_t start = chunk->input.size();
+            chunk->input.resize(start + CHUNK_SIZE);
+            in.read(&chunk->input[start], static_cast<std::streamsize>(CHUNK_SIZE));
+            chunk->input.resize(start + static_cast<size_t>(in.gcount()));
+
+            // Keep the unfinished last line for the next chunk
+            const size_t lastNewline = chunk->input.rfind('\n');
+            if (in && lastNewline != std::string::npos)
+            {
+                carry.assign(chunk->input, lastNewline + 1, std::string::npos);
+                chunk->input.resize(lastNewline + 1);
+            }
+            else if (in)
+            {
+                carry.swap(chunk->input);
+                continue;
+            }
+
+            if (chunk->input.empty())
+            {
+                continue;
+            }
+
+            // Limit the number of chunks waiting to be evaluated or written
+            {
+                std::unique_lock<std::mutex> lock(doneMutex_);
+                doneChanged_.wait(lock, [&] { return inFlight_ < maxInFlight_; });
+                ++inFlight_;
+            }
+
+            WorkQueue& queue = queues_[index % queues_.size()];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.chunks.push_back(std::move(chunk));
+            }
+            ++index;
+
+            {
+                std::lock_guard<std::mutex> lock(workMutex_);
+                ++queued_;
+            }
+            workAvailable_.notify_one();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(workMutex_);
+            readerDone_ = true;
+        }
+        workAvailable_.notify_all();
+
+        {
+            std::lock_guard<std::mutex> lock(doneMutex_);
+            totalChunks_ = index;
+            totalKnown_ = true;
+        }
+        doneChanged_.notify_all();
+    }
+
+    // Worker thread: evaluate chunks from the own queue, stealing from the others when it runs dry
+    template <typename LineEvaluator>
+    void work(const unsigned id, LineEvaluator& evaluateLine)
+    {
+        while (true)
+        {
+            std::unique_ptr<Chunk> chunk = take(id);
+            if (!chunk)
+            {
+                std::unique_lock<std::mutex> lock(workMutex_);
+                workAvailable_.wait(lock, [&] { return queued_ > 0 || readerDone_; });
+                if (queued_ == 0 && readerDone_)
+                {
+                    return;
+                }
+                continue;
+            }
+
+            const char* line = chunk->input.data();
+            const char* end = line + chunk->input.size();
+            while (line < end)
+            {
+                const char* newline = static_cast<const char*>(memchr(line, '\n', end - line));
+                const char* lineEnd = newline ? newline : end;
+                evaluateLine(std::string_view(line, lineEnd - line), chunk->output);
+                line = lineEnd + 1;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(doneMutex_);
+                const size_t index = chunk->index;
+                done_.emplace(index, std::move(chunk));
+            }
+            doneChanged_.notify_all();
+        }
+    }
+
+    // Take a chunk from the worker's own queue, or steal one from another worker
+    std::unique_ptr<Chunk> take(const unsigned id)
+    {
+        for (size_t offset = 0; offset < queues_.size(); ++offset)
+        {
+            WorkQueue& queue = queues_[(id + offset) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.chunks.empty())
+            {
+                continue;
+            }
+
+            std::unique_ptr<Chunk> chunk;
+            if (offset == 0)
+            {
+                chunk = std::move(queue.chunks.front());
+                queue.chunks.pop_front();
+            }
+            else
+            {
+                chunk = std::move(queue.chunks.back());
+                queue.chunks.pop_back();
+            }
+
+            std::lock_guard<std::mutex> workLock(workMutex_);
+            --queued_;
+            return chunk;
+        }
+
+        return nullptr;
+    }
+
+    // Writer: emit finished chunks strictly in input order
+    void write(std::ostream& out)
+    {
+        for (size_t next = 0;; ++next)
+        {
+            std::unique_ptr<Chunk> chunk;
+            {
+                std::unique_lock<std::mutex> lock(doneMutex_);
+                doneChanged_.wait(lock, [&] {
+                    return done_.count(next) != 0 || (totalKnown_ && next == totalChunks_);
+                });
+                if (done_.count(next) == 0)
+                {
+                    break;
+                }
+                chunk = std::move(done_[next]);
+                done_.erase(next);
+            }
+
+            out.write(chunk->output.data(), static_cast<std::streamsize>(chunk->output.size()));
+
+            {
+                std::lock_guard<std::mutex> lock(doneMutex_);
+                --inFlight_;
+            }
+            doneChanged_.notify_all();
+        }
+
+        out.flush();
+    }
+
+    std::vector<WorkQueue> queues_;
+
+    // Work availability, guarded by workMutex_
+    std::mutex workMutex_;
+    std::condition_variable workAvailable_;
+    size_t queued_ = 0;
+    bool readerDone_ = false;
+
+    // Finished chunks and back-pressure, guarded by doneMutex_
+    std::mutex doneMutex_;
+    std::condition_variable doneChanged_;
+    std::map<size_t, std::unique_ptr<Chunk>> done_;
+    size_t inFlight_ = 0;
+    const size_t maxInFlight_;
+    size_t totalChunks_ = 0;
+    bool totalKnown_ = false;
+};
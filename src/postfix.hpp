@@ -0,0 +1,274 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+
+// Operation codes of a postfix program
+// Number tokens carry their value, variable tokens their slot, the remaining codes are operators
+// Square, SquareRoot and PowerInteger are unary and only produced by the optimizer
+// PowerInteger raises its operand to the integer exponent stored in the token value
+enum class OpCode : unsigned char
+{
+    Number,
+    Variable,
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Power,
+    Square,
+    SquareRoot,
+    PowerInteger
+};
+
+// Largest exponent magnitude handled by exponentiation by squaring instead of pow
+// Keeps the number of multiplications, and so the rounding error, small
+constexpr long long MAX_INTEGER_EXPONENT = 64;
+
+// Number of operands an operation takes from the stack
+inline int operandCount(const OpCode op)
+{
+    switch (op)
+    {
+        case OpCode::Number:
+        case OpCode::Variable:
+            return 0;
+        case OpCode::Square:
+        case OpCode::SquareRoot:
+        case OpCode::PowerInteger:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+// A single postfix token: an operation code, the variable slot and, for numbers, the pre-parsed value
+// Tokens are stored contiguously so evaluation never has to look at strings again
+struct Token
+{
+    OpCode op;
+    unsigned slot;
+    double value;
+};
+
+// Check whether an exponent qualifies for exponentiation by squaring
+constexpr bool isSmallIntegerExponent(const double exponent)
+{
+    return exponent >= -MAX_INTEGER_EXPONENT && exponent <= MAX_INTEGER_EXPONENT &&
+           exponent == static_cast<double>(static_cast<long long>(exponent));
+}
+
+// Raise a number to an integer power by repeated squaring
+// Negative exponents take the reciprocal, so 0 raised to a negative power is infinity like pow
+constexpr double powInteger(const double base, const long long exponent)
+{
+    double result = 1.0;
+    double factor = base;
+    for (unsigned long long n = exponent < 0 ? -exponent : exponent; n != 0; n >>= 1)
+    {
+        if (n & 1)
+        {
+            result *= factor;
+        }
+        factor *= factor;
+    }
+    return exponent < 0 ? 1.0 / result : result;
+}
+
+// Perform calculation based on the given operator
+// Supports addition, subtraction, multiplication, division, and exponentiation
+// Includes error handling for division by zero
+// constexpr so constant expressions can be folded at compile time; a division by zero is then a compile error
+constexpr double calculate(const double a, const double b, const OpCode op)
+{
+    switch (op)
+    {
+        case OpCode::Add:
+            return a + b;
+        case OpCode::Subtract:
+            return a - b;
+        case OpCode::Multiply:
+            return a * b;
+        case OpCode::Divide:
+            if (b == 0)
+            {
+                throw std::runtime_error("Divide by zero");
+            }
+            return a / b;
+        case OpCode::Power:
+            // Small integer exponents such as x^3 avoid the general pow routine
+            if (isSmallIntegerExponent(b))
+            {
+                return powInteger(a, static_cast<long long>(b));
+            }
+            return pow(a, b);
+        default:
+            throw std::runtime_error("Invalid operator");
+    }
+}
+
+// Perform a unary operation produced by the optimizer
+// argument is the value stored in the token, the exponent for PowerInteger
+inline double calculateUnary(const double a, const OpCode op, const double argument = 0.0)
+{
+    switch (op)
+    {
+        case OpCode::Square:
+            return a * a;
+        case OpCode::SquareRoot:
+            return sqrt(a);
+        case OpCode::PowerInteger:
+            return powInteger(a, static_cast<long long>(argument));
+        default:
+            throw std::runtime_error("Invalid operator");
+    }
+}
+
+// Check that every operator has its operands and exactly one value is left, without throwing
+inline bool isWellFormed(const std::vector<Token>& postfix)
+{
+    size_t depth = 0;
+    for (const Token& token : postfix)
+    {
+        const size_t operands = static_cast<size_t>(operandCount(token.op));
+        if (depth < operands)
+        {
+            return false;
+        }
+        depth = depth - operands + 1;
+    }
+    return depth == 1;
+}
+
+// Compute the deepest operand stack a postfix program needs
+// Also validates the program: every operator has its operands and exactly one value is left
+inline size_t maxStackDepth(const std::vector<Token>& postfix)
+{
+    size_t depth = 0;
+    size_t maxDepth = 0;
+    for (const Token& token : postfix)
+    {
+        const size_t operands = static_cast<size_t>(operandCount(token.op));
+        if (depth < operands)
+        {
+            throw std::runtime_error("Invalid expression");
+        }
+        depth = depth - operands + 1;
+        maxDepth = std::max(maxDepth, depth);
+    }
+
+    // A well-formed expression leaves exactly one value behind
+    if (depth != 1)
+    {
+        throw std::runtime_error("Invalid expression");
+    }
+
+    return maxDepth;
+}
+
+// Literals below 2^53 in magnitude are exactly the integer that was written, larger ones may be rounded
+constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;
+
+// Deepest operand stack of the integer path, deeper programs use double evaluation
+constexpr size_t INTEGER_STACK_SIZE = 64;
+
+// Overflow-checked 64-bit arithmetic, each returns false when the exact result does not fit
+inline bool checkedAdd(const long long a, const long long b, long long& result)
+{
+    return !__builtin_add_overflow(a, b, &result);
+}
+
+inline bool checkedSubtract(const long long a, const long long b, long long& result)
+{
+    return !__builtin_sub_overflow(a, b, &result);
+}
+
+inline bool checkedMultiply(const long long a, const long long b, long long& result)
+{
+    return !__builtin_mul_overflow(a, b, &result);
+}
+
+// Integer power by repeated squaring, false on overflow
+inline bool checkedPower(const long long base, unsigned long long exponent, long long& result)
+{
+    long long factor = base;
+    result = 1;
+    for (; exponent != 0; exponent >>= 1)
+    {
+        if ((exponent & 1) && !checkedMultiply(result, factor, result))
+        {
+            return false;
+        }
+        if (exponent > 1 && !checkedMultiply(factor, factor, factor))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Evaluate a postfix program exactly in 64-bit integers
+// Returns false, leaving the work to double evaluation, when the program is not pure integer
+// arithmetic (a fractional or very large literal, a variable, a division, a negative exponent),
+// when a result overflows, or when the program is malformed
+inline bool evaluateIntegerPostfix(const std::vector<Token>& postfix, long long& result)
+{
+    long long stack[INTEGER_STACK_SIZE];
+    size_t depth = 0;
+
+    for (const Token& token : postfix)
+    {
+        if (token.op == OpCode::Number)
+        {
+            const double value = token.value;
+            if (depth == INTEGER_STACK_SIZE || !(value > -MAX_EXACT_INTEGER && value < MAX_EXACT_INTEGER) ||
+                value != static_cast<double>(static_cast<long long>(value)))
+            {
+                return false;
+            }
+            stack[depth++] = static_cast<long long>(value);
+            continue;
+        }
+
+        if (operandCount(token.op) != 2 || depth < 2)
+        {
+            return false;
+        }
+        const long long b = stack[--depth];
+        long long& a = stack[depth - 1];
+        bool exact = false;
+        switch (token.op)
+        {
+            case OpCode::Add:
+                exact = checkedAdd(a, b, a);
+                break;
+            case OpCode::Subtract:
+                exact = checkedSubtract(a, b, a);
+                break;
+            case OpCode::Multiply:
+                exact = checkedMultiply(a, b, a);
+                break;
+            case OpCode::Power:
+                exact = b >= 0 && checkedPower(a, static_cast<unsigned long long>(b), a);
+                break;
+            default:
+                break;
+        }
+        if (!exact)
+        {
+            return false;
+        }
+    }
+
+    if (depth != 1)
+    {
+        return false;
+    }
+    result = stack[0];
+    return true;
+}
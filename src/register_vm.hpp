@@ -0,0 +1,161 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <memory_resource>
+
+#include "postfix.hpp"
+#include "optimizer.hpp"
+
+// Largest register file kept in a local array while the threaded code runs
+// Larger programs use a heap buffer that is allocated once per thread and then reused
+constexpr size_t INLINE_REGISTER_COUNT = 64;
+
+// A three-address instruction: registers[dst] = registers[left] op registers[right]
+// Unary operators ignore right, argument holds the exponent of PowerInteger
+struct RegisterInstruction
+{
+    OpCode op;
+    unsigned dst;
+    unsigned left;
+    unsigned right;
+    double argument;
+};
+
+// RegisterProgram: An expression translated to three-address code over a register file
+// Not run itself: ThreadedProgram::fromRegisters lowers it to the code evaluate() executes
+// The register file is laid out as [constants][variables][temporaries]: constants and variables
+// are operands in place, so no instruction exists just to move a value onto a stack
+class RegisterProgram {
+public:
+    // Translate an expression DAG that references variableCount variable slots
+    // Every node reachable from the root is computed exactly once, however many operators share it
+    // Working tables come from the tree's memory resource, the program itself from the heap
+    static RegisterProgram fromTree(const ExpressionTree& tree, const size_t variableCount)
+    {
+        RegisterProgram program;
+        program.variableCount_ = variableCount;
+
+        const std::pmr::vector<ExpressionNode>& nodes = tree.nodes();
+        const std::pmr::vector<bool> used = tree.reachable();
+
+        // Number of operators reading each node; the root is also read as the result
+        std::pmr::vector<unsigned> readers(nodes.size(), 0, tree.memory());
+        ++readers[tree.root()];
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const int count = used[i] ? operandCount(nodes[i].op) : 0;
+            if (count >= 1)
+            {
+                ++readers[nodes[i].left];
+            }
+            if (count == 2)
+            {
+                ++readers[nodes[i].right];
+            }
+        }
+
+        // Give every constant node its own register; hash-consing already made them distinct
+        std::pmr::vector<unsigned> registers(nodes.size(), 0, tree.memory());
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            if (used[i] && nodes[i].op == OpCode::Number)
+            {
+                registers[i] = static_cast<unsigned>(program.constants_.size());
+                program.constants_.push_back(nodes[i].value);
+            }
+        }
+
+        const unsigned firstVariable = static_cast<unsigned>(program.constants_.size());
+        const unsigned firstTemporary = firstVariable + static_cast<unsigned>(variableCount);
+        unsigned temporaryCount = 0;
+
+        // Temporaries are freed once their last reader has run and handed out again lowest first
+        std::pmr::vector<unsigned> freeTemporaries(tree.memory());
+        const auto release = [&](const size_t node) {
+            if (--readers[node] == 0 && registers[node] >= firstTemporary)
+            {
+                freeTemporaries.push_back(registers[node]);
+                std::push_heap(freeTemporaries.begin(), freeTemporaries.end(), std::greater<>());
+            }
+        };
+        const auto acquire = [&]() {
+            if (freeTemporaries.empty())
+            {
+                return firstTemporary + temporaryCount++;
+            }
+            std::pop_heap(freeTemporaries.begin(), freeTemporaries.end(), std::greater<>());
+            const unsigned reg = freeTemporaries.back();
+            freeTemporaries.pop_back();
+            return reg;
+        };
+
+        // Operands precede their operators, so node order is a valid evaluation order
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const ExpressionNode& node = nodes[i];
+            if (!used[i] || node.op == OpCode::Number)
+            {
+                continue;
+            }
+
+            if (node.op == OpCode::Variable)
+            {
+                registers[i] = firstVariable + node.slot;
+                continue;
+            }
+
+            const unsigned left = registers[node.left];
+            const bool binary = operandCount(node.op) == 2;
+            const unsigned right = binary ? registers[node.right] : left;
+            release(node.left);
+            if (binary)
+            {
+                release(node.right);
+            }
+            registers[i] = acquire();
+            program.instructions_.push_back({node.op, registers[i], left, right, binary ? 0.0 : node.value});
+        }
+
+        program.result_ = registers[tree.root()];
+        program.registerCount_ = firstTemporary + temporaryCount;
+        return program;
+    }
+
+    const std::vector<RegisterInstruction>& instructions() const
+    {
+        return instructions_;
+    }
+
+    const std::vector<double>& constants() const
+    {
+        return constants_;
+    }
+
+    size_t variableCount() const
+    {
+        return variableCount_;
+    }
+
+    size_t registerCount() const
+    {
+        return registerCount_;
+    }
+
+    // Register holding the value of the expression once the program has run
+    unsigned result() const
+    {
+        return result_;
+    }
+
+private:
+    std::vector<RegisterInstruction> instructions_;
+    std::vector<double> constants_;
+    size_t variableCount_ = 0;
+    size_t registerCount_ = 0;
+    unsigned result_ = 0;
+};
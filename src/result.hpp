@@ -0,0 +1,152 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <utility>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+// Kinds of errors reported by the lexer, the compiler and the evaluator
+enum class ErrorKind : unsigned char
+{
+    None,
+    InvalidExpression,
+    InvalidNumber,
+    NumberOutOfRange,
+    UnknownIdentifier,
+    DivideByZero,
+    InvalidVariable
+};
+
+// An error found while translating or evaluating an expression, reported without throwing
+// position and length locate the offending text in the expression: the number or name for lexical
+// errors, the whole expression for structural errors and for division by zero, which is only detected
+// while the compiled program runs. For an invalid variable name, position is its index in the list of
+// variables and length is 0. negative records a unary minus that belongs to a number.
+struct EvaluationError
+{
+    ErrorKind kind = ErrorKind::None;
+    size_t position = 0;
+    size_t length = 0;
+    bool negative = false;
+
+    constexpr explicit operator bool() const
+    {
+        return kind != ErrorKind::None;
+    }
+};
+
+// The text of an error, the same as the message of the exception the throwing API raises
+inline std::string errorMessage(const EvaluationError& error, const std::string_view expression)
+{
+    const std::string text = std::string(error.negative ? "-" : "") +
+                             std::string(expression.substr(std::min(error.position, expression.length()), error.length));
+    switch (error.kind)
+    {
+        case ErrorKind::InvalidExpression:
+            return "Invalid expression";
+        case ErrorKind::InvalidNumber:
+            return "Invalid number format in expression: " + text;
+        case ErrorKind::NumberOutOfRange:
+            return "Number out of range in expression: " + text;
+        case ErrorKind::UnknownIdentifier:
+            return "Unknown identifier in expression: " + text;
+        case ErrorKind::DivideByZero:
+            return "Divide by zero";
+        case ErrorKind::InvalidVariable:
+            return "Invalid variable name at index " + std::to_string(error.position);
+        default:
+            return std::string();
+    }
+}
+
+// Throw the exception the throwing API has always used for an error:
+// std::invalid_argument for lexical errors and invalid variable names, std::runtime_error otherwise
+[[noreturn]] inline void throwError(const EvaluationError& error, const std::string_view expression)
+{
+    switch (error.kind)
+    {
+        case ErrorKind::InvalidNumber:
+        case ErrorKind::NumberOutOfRange:
+        case ErrorKind::UnknownIdentifier:
+        case ErrorKind::InvalidVariable:
+            throw std::invalid_argument(errorMessage(error, expression));
+        default:
+            throw std::runtime_error(errorMessage(error, expression));
+    }
+}
+
+// Result: Either a value or the error that prevented computing it, like std::expected
+template<typename T>
+class Result {
+public:
+    Result(T value)
+        : value_(std::move(value))
+    {
+    }
+
+    Result(const EvaluationError& error)
+        : error_(error)
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return !error_;
+    }
+
+    const T& value() const&
+    {
+        return *value_;
+    }
+
+    T&& value() &&
+    {
+        return std::move(*value_);
+    }
+
+    const EvaluationError& error() const
+    {
+        return error_;
+    }
+
+private:
+    std::optional<T> value_;
+    EvaluationError error_;
+};
+
+// Result<void>: Success, or the error of an operation that produces no value
+template<>
+class Result<void> {
+public:
+    Result() = default;
+
+    Result(const EvaluationError& error)
+        : error_(error)
+    {
+    }
+
+    explicit operator bool() const
+    {
+        return !error_;
+    }
+
+    const EvaluationError& error() const
+    {
+        return error_;
+    }
+
+private:
+    EvaluationError error_;
+};
+
+// Hit and miss counts of one or more expression caches
+struct CacheStatistics
+{
+    std::size_t hits;
+    std::size_t misses;
+};
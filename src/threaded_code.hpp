@@ -0,0 +1,257 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+
+#include "postfix.hpp"
+#include "register_vm.hpp"
+
+// ThreadedProgram: Register code with every instruction pre-resolved to its handler function
+// Evaluation calls each handler directly instead of switching on the operation code, and common
+// instruction pairs are fused into superinstructions:
+//   t = a * b; d = t + c   ->  d = a * b + c   (also t - c and c - t; two roundings, not an FMA)
+//   d = a op constant      ->  constant taken as an immediate, division needs no zero check
+// A zero divisor sets a flag register rather than throwing, so the hot loop has no exception paths
+class ThreadedProgram {
+public:
+    // Build from register code; the register layout is the same as the register program's
+    static ThreadedProgram fromRegisters(const RegisterProgram& registers)
+    {
+        ThreadedProgram program;
+        program.constants_ = registers.constants();
+        program.variableCount_ = registers.variableCount();
+        program.registerCount_ = registers.registerCount();
+        program.result_ = registers.result();
+
+        const std::vector<RegisterInstruction>& code = registers.instructions();
+        const std::vector<bool> deadAfter = consumedRegisters(registers);
+        const unsigned constantCount = static_cast<unsigned>(registers.constants().size());
+        const auto isConstant = [&](const unsigned reg) { return reg < constantCount; };
+
+        for (size_t i = 0; i < code.size(); ++i)
+        {
+            const RegisterInstruction& instruction = code[i];
+
+            // Multiply followed by an add or subtract that is the only reader of the product
+            if (instruction.op == OpCode::Multiply && i + 1 < code.size() && deadAfter[i + 1])
+            {
+                const RegisterInstruction& next = code[i + 1];
+                const unsigned product = instruction.dst;
+                const bool productLeft = next.left == product && next.right != product;
+                const bool productRight = next.right == product && next.left != product;
+
+                Handler fused = nullptr;
+                unsigned other = 0;
+                if (next.op == OpCode::Add && (productLeft || productRight))
+                {
+                    fused = &multiplyAdd;
+                    other = productLeft ? next.right : next.left;
+                }
+                else if (next.op == OpCode::Subtract && productLeft)
+                {
+                    fused = &multiplySubtract;
+                    other = next.right;
+                }
+                else if (next.op == OpCode::Subtract && productRight)
+                {
+                    fused = &subtractMultiply;
+                    other = next.left;
+                }
+
+                if (fused)
+                {
+                    program.code_.push_back({fused, next.dst, instruction.left, instruction.right, other, 0.0});
+                    ++i;
+                    continue;
+                }
+            }
+
+            // Binary operation with a constant right operand
+            if (operandCount(instruction.op) == 2 && isConstant(instruction.right) &&
+                instruction.op != OpCode::Power)
+            {
+                const double constant = registers.constants()[instruction.right];
+                Handler handler = nullptr;
+                switch (instruction.op)
+                {
+                    case OpCode::Add: handler = &addConstant; break;
+                    case OpCode::Subtract: handler = &subtractConstant; break;
+                    case OpCode::Multiply: handler = &multiplyConstant; break;
+                    case OpCode::Divide: handler = constant == 0 ? &divide : &divideConstant; break;
+                    default: break;
+                }
+                program.code_.push_back({handler, instruction.dst, instruction.left, instruction.right, 0, constant});
+                continue;
+            }
+
+            program.code_.push_back({handlerFor(instruction.op), instruction.dst, instruction.left, instruction.right,
+                                     0, instruction.argument});
+        }
+
+        // Divisions by a register record a zero divisor in the flag register instead of throwing
+        for (Instruction& instruction : program.code_)
+        {
+            if (instruction.handler == &divide)
+            {
+                instruction.c = program.flagRegister();
+            }
+        }
+
+        return program;
+    }
+
+    // Evaluate with variables pointing to one value per variable slot
+    // Throws std::runtime_error("Divide by zero") like calculate
+    double evaluate(const double* variables) const
+    {
+        double result = 0.0;
+        if (!evaluate(variables, result))
+        {
+            throw std::runtime_error("Divide by zero");
+        }
+        return result;
+    }
+
+    // Non-throwing evaluation: stores the value in result, false when a division by zero occurred
+    bool evaluate(const double* variables, double& result) const
+    {
+        if (flagRegister() < INLINE_REGISTER_COUNT)
+        {
+            double registers[INLINE_REGISTER_COUNT];
+            return run(variables, registers, result);
+        }
+
+        thread_local std::vector<double> registers;
+        if (registers.size() <= flagRegister())
+        {
+            registers.resize(flagRegister() + 1);
+        }
+        return run(variables, registers.data(), result);
+    }
+
+    // Number of instructions after fusion
+    size_t size() const
+    {
+        return code_.size();
+    }
+
+private:
+    struct Instruction;
+    using Handler = void (*)(double*, const Instruction&);
+
+    // A pre-resolved instruction: handler plus up to three register operands and an immediate
+    struct Instruction
+    {
+        Handler handler;
+        unsigned dst;
+        unsigned a;
+        unsigned b;
+        unsigned c;
+        double immediate;
+    };
+
+    // The register after the register file, set to non-zero when a divisor was zero
+    unsigned flagRegister() const
+    {
+        return static_cast<unsigned>(registerCount_);
+    }
+
+    bool run(const double* variables, double* registers, double& result) const
+    {
+        std::copy(constants_.begin(), constants_.end(), registers);
+        for (size_t k = 0; k < variableCount_; ++k)
+        {
+            registers[constants_.size() + k] = variables[k];
+        }
+        registers[flagRegister()] = 0.0;
+
+        for (const Instruction& instruction : code_)
+        {
+            instruction.handler(registers, instruction);
+        }
+
+        result = registers[result_];
+        return registers[flagRegister()] == 0.0;
+    }
+
+    // For every instruction, whether the value it reads from the previous instruction's
+    // destination is dead afterwards, i.e. that instruction is the product's only reader
+    static std::vector<bool> consumedRegisters(const RegisterProgram& registers)
+    {
+        const std::vector<RegisterInstruction>& code = registers.instructions();
+        std::vector<bool> deadAfter(code.size(), false);
+        std::vector<bool> live(registers.registerCount(), false);
+        live[registers.result()] = true;
+
+        for (size_t i = code.size(); i-- > 0;)
+        {
+            const RegisterInstruction& instruction = code[i];
+            if (i > 0)
+            {
+                const unsigned previous = code[i - 1].dst;
+                deadAfter[i] = !live[previous] || instruction.dst == previous;
+            }
+
+            live[instruction.dst] = false;
+            live[instruction.left] = true;
+            if (operandCount(instruction.op) == 2)
+            {
+                live[instruction.right] = true;
+            }
+        }
+
+        return deadAfter;
+    }
+
+    static Handler handlerFor(const OpCode op)
+    {
+        switch (op)
+        {
+            case OpCode::Add: return &add;
+            case OpCode::Subtract: return &subtract;
+            case OpCode::Multiply: return &multiply;
+            case OpCode::Divide: return &divide;
+            case OpCode::Power: return &power;
+            case OpCode::Square: return &square;
+            case OpCode::SquareRoot: return &squareRoot;
+            case OpCode::PowerInteger: return &powerInteger;
+            default: throw std::runtime_error("Invalid operator");
+        }
+    }
+
+    static void add(double* r, const Instruction& i) { r[i.dst] = r[i.a] + r[i.b]; }
+    static void subtract(double* r, const Instruction& i) { r[i.dst] = r[i.a] - r[i.b]; }
+    static void multiply(double* r, const Instruction& i) { r[i.dst] = r[i.a] * r[i.b]; }
+    static void divide(double* r, const Instruction& i)
+    {
+        r[i.c] = r[i.b] == 0 ? 1.0 : r[i.c];
+        r[i.dst] = r[i.a] / r[i.b];
+    }
+    static void power(double* r, const Instruction& i) { r[i.dst] = calculate(r[i.a], r[i.b], OpCode::Power); }
+    static void square(double* r, const Instruction& i) { r[i.dst] = r[i.a] * r[i.a]; }
+    static void squareRoot(double* r, const Instruction& i) { r[i.dst] = sqrt(r[i.a]); }
+    static void powerInteger(double* r, const Instruction& i)
+    {
+        r[i.dst] = powInteger(r[i.a], static_cast<long long>(i.immediate));
+    }
+
+    static void addConstant(double* r, const Instruction& i) { r[i.dst] = r[i.a] + i.immediate; }
+    static void subtractConstant(double* r, const Instruction& i) { r[i.dst] = r[i.a] - i.immediate; }
+    static void multiplyConstant(double* r, const Instruction& i) { r[i.dst] = r[i.a] * i.immediate; }
+    static void divideConstant(double* r, const Instruction& i) { r[i.dst] = r[i.a] / i.immediate; }
+
+    static void multiplyAdd(double* r, const Instruction& i) { r[i.dst] = r[i.a] * r[i.b] + r[i.c]; }
+    static void multiplySubtract(double* r, const Instruction& i) { r[i.dst] = r[i.a] * r[i.b] - r[i.c]; }
+    static void subtractMultiply(double* r, const Instruction& i) { r[i.dst] = r[i.c] - r[i.a] * r[i.b]; }
+
+    std::vector<Instruction> code_;
+    std::vector<double> constants_;
+    size_t variableCount_ = 0;
+    size_t registerCount_ = 0;
+    unsigned result_ = 0;
+};
@@ -0,0 +1,151 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <stdexcept>
+
+#include "postfix.hpp"
+
+// Number of rows evaluated together by the column kernels
+// Small enough for the operand blocks of typical programs to stay in the L1 cache
+constexpr std::size_t COLUMN_BLOCK = 256;
+
+// Apply a binary operator element-wise: a[i] = a[i] op b[i]
+// Each case is a flat loop without calls or data-dependent branches so the compiler can vectorize it
+// Returns false, leaving a unchanged, when the operator divides and any b[i] is zero
+inline bool applyKernel(const OpCode op, double* a, const double* b, const std::size_t n)
+{
+    switch (op)
+    {
+        case OpCode::Add:
+            for (std::size_t i = 0; i < n; ++i) a[i] += b[i];
+            return true;
+        case OpCode::Subtract:
+            for (std::size_t i = 0; i < n; ++i) a[i] -= b[i];
+            return true;
+        case OpCode::Multiply:
+            for (std::size_t i = 0; i < n; ++i) a[i] *= b[i];
+            return true;
+        case OpCode::Divide:
+        {
+            // Same divide by zero rule as calculate, checked for the whole block up front
+            bool hasZero = false;
+            for (std::size_t i = 0; i < n; ++i) hasZero |= (b[i] == 0);
+            if (hasZero)
+            {
+                return false;
+            }
+            for (std::size_t i = 0; i < n; ++i) a[i] /= b[i];
+            return true;
+        }
+        case OpCode::Power:
+            // Same small integer exponent rule as calculate, so rows match single evaluation exactly
+            for (std::size_t i = 0; i < n; ++i) a[i] = calculate(a[i], b[i], OpCode::Power);
+            return true;
+        default:
+            throw std::runtime_error("Invalid operator");
+    }
+}
+
+// Apply a unary operator element-wise: a[i] = op(a[i])
+// argument is the value stored in the token, the exponent for PowerInteger
+inline void applyUnaryKernel(const OpCode op, double* a, const std::size_t n, const double argument)
+{
+    switch (op)
+    {
+        case OpCode::Square:
+            for (std::size_t i = 0; i < n; ++i) a[i] *= a[i];
+            return;
+        case OpCode::SquareRoot:
+            for (std::size_t i = 0; i < n; ++i) a[i] = sqrt(a[i]);
+            return;
+        case OpCode::PowerInteger:
+        {
+            // Exponentiation by squaring with the bit loop outside, so each step is one flat loop
+            const long long exponent = static_cast<long long>(argument);
+            double result[COLUMN_BLOCK];
+            std::fill(result, result + n, 1.0);
+            for (unsigned long long bits = exponent < 0 ? -exponent : exponent; bits != 0; bits >>= 1)
+            {
+                if (bits & 1)
+                {
+                    for (std::size_t i = 0; i < n; ++i) result[i] *= a[i];
+                }
+                for (std::size_t i = 0; i < n; ++i) a[i] *= a[i];
+            }
+            if (exponent < 0)
+            {
+                for (std::size_t i = 0; i < n; ++i) a[i] = 1.0 / result[i];
+            }
+            else
+            {
+                std::copy(result, result + n, a);
+            }
+            return;
+        }
+        default:
+            throw std::runtime_error("Invalid operator");
+    }
+}
+
+// Evaluate a postfix program once per row of the input columns
+// columns[slot] points to count values of that variable, results receives count values
+// The operand stack holds whole blocks of rows, so every operator runs as one kernel per block
+// Returns false when any row divides by zero; the results are then unspecified
+inline bool tryEvaluatePostfixColumns(const std::vector<Token>& postfix, const double* const* columns,
+                                      const std::size_t count, double* results)
+{
+    // Validate the program and find the deepest operand stack it needs
+    const std::size_t maxDepth = maxStackDepth(postfix);
+    std::vector<double> stack(maxDepth * COLUMN_BLOCK);
+
+    for (std::size_t start = 0; start < count; start += COLUMN_BLOCK)
+    {
+        const std::size_t n = std::min(COLUMN_BLOCK, count - start);
+        double* top = stack.data();
+
+        for (const Token& token : postfix)
+        {
+            if (token.op == OpCode::Number)
+            {
+                std::fill(top, top + n, token.value);
+                top += COLUMN_BLOCK;
+            }
+            else if (token.op == OpCode::Variable)
+            {
+                std::copy(columns[token.slot] + start, columns[token.slot] + start + n, top);
+                top += COLUMN_BLOCK;
+            }
+            else if (operandCount(token.op) == 1)
+            {
+                applyUnaryKernel(token.op, top - COLUMN_BLOCK, n, token.value);
+            }
+            else
+            {
+                top -= COLUMN_BLOCK;
+                if (!applyKernel(token.op, top - COLUMN_BLOCK, top, n))
+                {
+                    return false;
+                }
+            }
+        }
+
+        std::copy(stack.data(), stack.data() + n, results + start);
+    }
+    return true;
+}
+
+// Throwing form of tryEvaluatePostfixColumns
+// Throws std::runtime_error("Divide by zero") like calculate when any row divides by zero
+inline void evaluatePostfixColumns(const std::vector<Token>& postfix, const double* const* columns,
+                                   const std::size_t count, double* results)
+{
+    if (!tryEvaluatePostfixColumns(postfix, columns, count, results))
+    {
+        throw std::runtime_error("Divide by zero");
+    }
+}
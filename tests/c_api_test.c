@@ -0,0 +1,120 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+// Test of the C interface of the calccore library, built as C99 so that calc.h is checked as a C header
+
+#include <math.h>
+#include <stdio.h>
+
+#include "calc.h"
+
+static int failures = 0;
+
+// Report a failed check with its line, and keep going so one run shows every failure
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                                   \
+        }                                                                                 \
+    } while (0)
+
+static void testEvaluate(void)
+{
+    const char* names[] = {"x", "y"};
+    calc_expression* f = NULL;
+    calc_error error;
+    CHECK(calc_prepare("x^2 + 2x*y", names, 2, &f, &error) == CALC_OK);
+    CHECK(f != NULL && error.status == CALC_OK);
+
+    double value = 0.0;
+    CHECK(calc_eval(f, &value) == CALC_OK && value == 0.0);
+    CHECK(calc_bind(f, 0, 3.0) == CALC_OK);
+    CHECK(calc_bind(f, 1, 4.0) == CALC_OK);
+    CHECK(calc_eval(f, &value) == CALC_OK && value == 33.0);
+    CHECK(calc_bind(f, 2, 1.0) == CALC_INVALID_ARGUMENT);
+
+    const double xs[] = {1.0, 2.0, 3.0};
+    const double ys[] = {0.0, 1.0, -1.0};
+    const double* columns[] = {xs, ys};
+    double results[3];
+    CHECK(calc_eval_batch(f, columns, 3, results) == CALC_OK);
+    CHECK(results[0] == 1.0 && results[1] == 8.0 && results[2] == 3.0);
+    calc_free(f);
+}
+
+static void testDivideByZero(void)
+{
+    const char* names[] = {"x"};
+    calc_expression* f = NULL;
+    CHECK(calc_prepare("1/x", names, 1, &f, NULL) == CALC_OK);
+
+    double value = 0.0;
+    CHECK(calc_eval(f, &value) == CALC_DIVIDE_BY_ZERO);
+
+    const double xs[] = {1.0, 0.0};
+    const double* columns[] = {xs};
+    double results[2];
+    CHECK(calc_eval_batch(f, columns, 2, results) == CALC_DIVIDE_BY_ZERO);
+    CHECK(calc_eval_batch(f, columns, 1, results) == CALC_OK && results[0] == 1.0);
+    calc_free(f);
+
+    // A NaN that is the genuine result, not a division by zero, whether or not native code runs
+    CHECK(calc_prepare("x * 0 + 1/(x + 1)", names, 1, &f, NULL) == CALC_OK);
+    CHECK(calc_bind(f, 0, INFINITY) == CALC_OK);
+    CHECK(calc_eval(f, &value) == CALC_OK && isnan(value));
+    CHECK(calc_bind(f, 0, -1.0) == CALC_OK);
+    CHECK(calc_eval(f, &value) == CALC_DIVIDE_BY_ZERO);
+    calc_free(f);
+}
+
+static void testPrepareErrors(void)
+{
+    calc_expression* f = NULL;
+    calc_error error;
+    CHECK(calc_prepare("2 * foo + 1", NULL, 0, &f, &error) == CALC_UNKNOWN_IDENTIFIER);
+    CHECK(f == NULL && error.status == CALC_UNKNOWN_IDENTIFIER && error.position == 4 && error.length == 3);
+
+    CHECK(calc_prepare("(1 +", NULL, 0, &f, &error) == CALC_INVALID_EXPRESSION);
+    CHECK(calc_prepare("1e999", NULL, 0, &f, &error) == CALC_NUMBER_OUT_OF_RANGE);
+    CHECK(calc_prepare(NULL, NULL, 0, &f, &error) == CALC_INVALID_ARGUMENT && error.status == CALC_INVALID_ARGUMENT);
+
+    const char* duplicate[] = {"x", "x"};
+    CHECK(calc_prepare("x", duplicate, 2, &f, &error) == CALC_INVALID_VARIABLE && error.position == 0);
+    const char* constant[] = {"y", "e"};
+    CHECK(calc_prepare("e + y", constant, 2, &f, &error) == CALC_INVALID_VARIABLE && error.position == 1);
+    const char* empty[] = {""};
+    CHECK(calc_prepare("1", empty, 1, &f, &error) == CALC_INVALID_VARIABLE);
+    CHECK(f == NULL);
+}
+
+static void testConstants(void)
+{
+    calc_expression* f = NULL;
+    CHECK(calc_prepare("2pi - e", NULL, 0, &f, NULL) == CALC_OK);
+
+    double value = 0.0;
+    CHECK(calc_eval(f, &value) == CALC_OK && fabs(value - 3.5649033) < 1e-6);
+    CHECK(calc_eval_batch(f, NULL, 0, NULL) == CALC_OK);
+    calc_free(f);
+    calc_free(NULL);
+
+    CHECK(calc_eval(NULL, &value) == CALC_INVALID_ARGUMENT);
+    CHECK(calc_status_message(CALC_DIVIDE_BY_ZERO)[0] == 'D');
+}
+
+int main(void)
+{
+    testEvaluate();
+    testDivideByZero();
+    testPrepareErrors();
+    testConstants();
+
+    if (failures != 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 Lin Phone Pyae Han & Zaw Lin Than. All rights reserved
+
+// Test of ScientificCalculator::eval called at run time, where it is not limited to constant expressions
+
+#include <string>
+#include <cstdio>
+#include <stdexcept>
+
+#include "calculator.hpp"
+
+static int failures = 0;
+
+// Report a failed check with its line, and keep going so one run shows every failure
+#define CHECK(condition)                                                                       \
+    do                                                                                         \
+    {                                                                                          \
+        if (!(condition))                                                                      \
+        {                                                                                      \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures;                                                                        \
+        }                                                                                      \
+    } while (0)
+
+// Whether eval throws an Exception for the expression
+template <typename Exception>
+static bool throws(const std::string& expression)
+{
+    try
+    {
+        ScientificCalculator::eval(expression);
+    }
+    catch (const Exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+// Nesting beyond the fixed stacks of constant evaluation
+static void testDeepNesting()
+{
+    const std::string nested = std::string(100, '(') + "1+2" + std::string(100, ')') + " * 2";
+    CHECK(ScientificCalculator::eval(nested) == 6);
+
+    std::string sum = "1";
+    for (int i = 0; i < 100; ++i)
+    {
+        sum = "(" + sum + "+1)";
+    }
+    CHECK(ScientificCalculator::eval(sum) == 101);
+
+    CHECK(throws<std::runtime_error>(std::string(100, '(') + "1+" + std::string(100, ')')));
+}
+
+static void testErrors()
+{
+    CHECK(ScientificCalculator::eval(std::string("2*(3+pi)")) == 2 * (3 + 3.14159265358979323846));
+    CHECK(throws<std::runtime_error>("1/0"));
+    CHECK(throws<std::invalid_argument>("2x"));
+}
+
+int main()
+{
+    testDeepNesting();
+    testErrors();
+
+    if (failures != 0)
+    {
+        std::fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
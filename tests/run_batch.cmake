@@ -0,0 +1,25 @@
+# Run Calculator --batch over INPUT and compare the output with EXPECTED
+# Usage: cmake -DCALCULATOR=<program> -DINPUT=<file> -DEXPECTED=<file> [-DTHREADS=<n>] -P run_batch.cmake
+# With THREADS the input is read from stdin by the parallel pipeline instead of being opened by path
+if (DEFINED THREADS)
+    execute_process(
+            COMMAND ${CALCULATOR} --batch --threads ${THREADS}
+            INPUT_FILE ${INPUT}
+            OUTPUT_VARIABLE output
+            RESULT_VARIABLE result
+    )
+else ()
+    execute_process(
+            COMMAND ${CALCULATOR} --batch ${INPUT}
+            OUTPUT_VARIABLE output
+            RESULT_VARIABLE result
+    )
+endif ()
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Calculator --batch exited with ${result}")
+endif ()
+
+file(READ ${EXPECTED} expected)
+if (NOT output STREQUAL expected)
+    message(FATAL_ERROR "Output differs from ${EXPECTED}:\n${output}")
+endif ()